@@ -1,7 +1,10 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <string_view>
+#include <type_traits>
 
 namespace hmr::bitwise
 {
@@ -21,16 +24,39 @@ auto xor_with_key(std::string_view input, uint8_t key) noexcept -> std::string;
 
 
 ////////////////////////////////////////////////////////////
-auto xor_rolling(std::string_view input, xor_differential differential = xor_differential::input) noexcept -> std::string;
+// The _inplace variants of these functions overwrite the data they're given, rather than returning a modified copy of it
+auto xor_with_key_inplace(char *data, std::size_t len, std::string_view key) noexcept -> void;
+auto xor_with_key_inplace(char *data, std::size_t len, uint8_t key) noexcept -> void;
+
+inline auto xor_with_key_inplace(std::string &input, std::string_view key) noexcept -> void { xor_with_key_inplace(input.data(), input.size(), key); }
+inline auto xor_with_key_inplace(std::string &input, uint8_t key) noexcept -> void { xor_with_key_inplace(input.data(), input.size(), key); }
+
+
+////////////////////////////////////////////////////////////
+// In output differential mode, large inputs are split across threads. A thread_count of 0 picks one based on the hardware and the input size
+auto xor_rolling(std::string_view input, xor_differential differential = xor_differential::input, std::size_t thread_count = 0) noexcept -> std::string;
+
+
+////////////////////////////////////////////////////////////
+// The offset starts the key stream that many bytes in, so a long input can be split into chunks that are each processed separately
+auto xor_counter(std::string_view input, uint8_t key = 0x00, int increment = 1, std::size_t offset = 0) noexcept -> std::string;
+
+auto xor_counter_inplace(char *data, std::size_t len, uint8_t key = 0x00, int increment = 1, std::size_t offset = 0) noexcept -> void;
+inline auto xor_counter_inplace(std::string &input, uint8_t key = 0x00, int increment = 1, std::size_t offset = 0) noexcept -> void { xor_counter_inplace(input.data(), input.size(), key, increment, offset); }
 
 
 ////////////////////////////////////////////////////////////
-auto xor_counter(std::string_view input, uint8_t key = 0x00, int increment = 1) noexcept -> std::string;
+// XORs two equal-length buffers together, throwing hmr::xcpt::bitwise::invalid_input if they differ. The output can be either input
+auto xor_buffers(std::string_view lhs, std::string_view rhs, char *output) -> void;
+auto xor_buffers(std::string_view lhs, std::string_view rhs) -> std::string;
 
 
 ////////////////////////////////////////////////////////////
 auto shift_left(std::string_view input, std::size_t amount = 1) noexcept -> std::string;
 
+auto shift_left_inplace(char *data, std::size_t len, std::size_t amount = 1) noexcept -> void;
+inline auto shift_left_inplace(std::string &input, std::size_t amount = 1) noexcept -> void { shift_left_inplace(input.data(), input.size(), amount); }
+
 
 ////////////////////////////////////////////////////////////
 template<typename T, typename = std::enable_if_t<std::is_integral_v<T> && !std::is_base_of_v<std::string, T>>>
@@ -48,6 +74,9 @@ auto shift_left(T input, std::size_t amount = 1) noexcept -> T
 ////////////////////////////////////////////////////////////
 auto shift_right(std::string_view input, std::size_t amount = 1) noexcept -> std::string;
 
+auto shift_right_inplace(char *data, std::size_t len, std::size_t amount = 1) noexcept -> void;
+inline auto shift_right_inplace(std::string &input, std::size_t amount = 1) noexcept -> void { shift_right_inplace(input.data(), input.size(), amount); }
+
 
 ////////////////////////////////////////////////////////////
 template<typename T, typename = std::enable_if_t<std::is_integral_v<T> && !std::is_base_of_v<std::string, T>>>
@@ -65,8 +94,14 @@ auto shift_right(T input, std::size_t amount = 1) noexcept -> T
 ////////////////////////////////////////////////////////////
 auto rotate_left(std::string_view input, std::size_t amount = 1, carry_through carry = carry_through::disabled) noexcept -> std::string;
 
+auto rotate_left_inplace(char *data, std::size_t len, std::size_t amount = 1, carry_through carry = carry_through::disabled) noexcept -> void;
+inline auto rotate_left_inplace(std::string &input, std::size_t amount = 1, carry_through carry = carry_through::disabled) noexcept -> void { rotate_left_inplace(input.data(), input.size(), amount, carry); }
+
 
 ////////////////////////////////////////////////////////////
 auto rotate_right(std::string_view input, std::size_t amount = 1, carry_through carry = carry_through::disabled) noexcept -> std::string;
 
+auto rotate_right_inplace(char *data, std::size_t len, std::size_t amount = 1, carry_through carry = carry_through::disabled) noexcept -> void;
+inline auto rotate_right_inplace(std::string &input, std::size_t amount = 1, carry_through carry = carry_through::disabled) noexcept -> void { rotate_right_inplace(input.data(), input.size(), amount, carry); }
+
 } // namespace hmr::bitwise
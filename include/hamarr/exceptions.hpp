@@ -25,6 +25,20 @@ public:
 
 namespace format
 {
+  ////////////////////////////////////////////////////////////
+  class file_error : public base
+  {
+  public:
+    file_error(std::string const &msg) : base(msg) {}
+  };
+
+  ////////////////////////////////////////////////////////////
+  class invalid_input : public base
+  {
+  public:
+    invalid_input(std::string const &msg) : base(msg) {}
+  };
+
   ////////////////////////////////////////////////////////////
   class need_more_data : public base
   {
@@ -156,4 +170,16 @@ namespace crypto
 } // namespace crypto
 
 
+namespace bitwise
+{
+  ////////////////////////////////////////////////////////////
+  class invalid_input : public base
+  {
+  public:
+    invalid_input(std::string const &msg) : base(msg) {}
+  };
+
+} // namespace bitwise
+
+
 } // namespace hmr::xcpt
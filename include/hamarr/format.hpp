@@ -1,23 +1,589 @@
 #pragma once
 
+#include <array>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <limits>
+#include <memory>
 #include <string>
 #include <string_view>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "exceptions.hpp"
+
 
 namespace hmr::fmt
 {
 
 using namespace std::string_view_literals;
 
+// Whether a delimiter string is a set of single-char delimiters, or one multi-char delimiter
+enum class delimiter_mode { any_char,
+  whole_string };
+
 auto to_upper(std::string_view input) -> std::string;
 auto to_lower(std::string_view input) -> std::string;
 
-auto escape(std::string_view input) -> std::string;
-auto unescape(std::string_view input) -> std::string;
+auto to_upper_inplace(char *data, std::size_t len) noexcept -> void;
+auto to_lower_inplace(char *data, std::size_t len) noexcept -> void;
+
+inline auto to_upper_inplace(std::string &input) noexcept -> void { to_upper_inplace(input.data(), input.size()); }
+inline auto to_lower_inplace(std::string &input) noexcept -> void { to_lower_inplace(input.data(), input.size()); }
+
+// ASCII case-insensitive comparisons, which never build lowercased copies of their inputs
+auto iequals(std::string_view lhs, std::string_view rhs) noexcept -> bool;
+auto istarts_with(std::string_view input, std::string_view prefix) noexcept -> bool;
+auto ifind(std::string_view input, std::string_view needle, std::size_t pos = 0) noexcept -> std::size_t;
+auto ihash(std::string_view input) noexcept -> std::size_t;
+
+// Functors for case-insensitive keys, e.g. std::unordered_map<std::string, T, hmr::fmt::case_insensitive_hash, hmr::fmt::case_insensitive_equal>.
+// They're marked transparent, but unordered containers only make use of that from C++20 - before then, a lookup by std::string_view still has
+// to build a std::string key
+struct case_insensitive_hash
+{
+  using is_transparent = void;
+
+  auto operator()(std::string_view input) const noexcept -> std::size_t { return ihash(input); }
+};
+
+struct case_insensitive_equal
+{
+  using is_transparent = void;
+
+  auto operator()(std::string_view lhs, std::string_view rhs) const noexcept -> bool { return iequals(lhs, rhs); }
+};
+
+// The escaping style used by escape/unescape - standard is hamarr's own \xHH style, json follows RFC 8259 string escapes and c_literal
+// follows C string literals
+enum class escape_mode
+{
+  standard,
+  json,
+  c_literal
+};
+
+auto escape(std::string_view input, escape_mode mode = escape_mode::standard) -> std::string;
+auto unescape(std::string_view input, escape_mode mode = escape_mode::standard) -> std::string;
+
+// Unescaping never makes the input longer, so it can be done in place - the char* overload returns the unescaped length
+auto unescape_inplace(char *data, std::size_t len, escape_mode mode = escape_mode::standard) -> std::size_t;
+inline auto unescape_inplace(std::string &input, escape_mode mode = escape_mode::standard) -> void { input.resize(unescape_inplace(input.data(), input.size(), mode)); }
+
+////////////////////////////////////////////////////////////
+// A set of byte values stored as a 256-bit table, so membership tests cost the same no matter how many bytes are in the set
+class byte_class
+{
+public:
+  byte_class() = default;
+  constexpr explicit byte_class(std::string_view members) noexcept;
+
+  auto contains(char c) const noexcept -> bool
+  {
+    auto const ch = static_cast<uint8_t>(c);
+    return ((bits_[ch >> 6] >> (ch & 63)) & 1) != 0;
+  }
+
+  auto find_first(char const *first, char const *last) const noexcept -> char const *; // Returns last if there is no member in [first, last)
+
+private:
+  std::array<uint64_t, 4> bits_{};
+
+  // Nibble lookup tables for SIMD classification - a byte is a member if lo_nibbles_[low nibble] & hi_nibbles_[high nibble] is non-zero
+  std::array<uint8_t, 16> lo_nibbles_{};
+  std::array<uint8_t, 16> hi_nibbles_{};
+  bool nibbles_exact_ = true; // False if the set is too irregular to be represented exactly by the nibble tables
+};
+
+
+////////////////////////////////////////////////////////////
+// Defined here so that tables of byte_classes can be built at compile time
+constexpr byte_class::byte_class(std::string_view members) noexcept
+{
+  // Each row records which low nibbles are present for a given high nibble
+  auto rows = std::array<uint16_t, 16>{};
+
+  for (auto const c : members)
+  {
+    auto const ch = static_cast<uint8_t>(c);
+
+    bits_[ch >> 6] |= (uint64_t{1} << (ch & 63));
+    rows[ch >> 4] |= static_cast<uint16_t>(1U << (ch & 0x0F));
+  }
+
+  // High nibbles with identical rows can share a bucket, and with 8 bits per table entry we can represent up to 8 distinct rows exactly
+  auto buckets = std::array<uint16_t, 8>{};
+  std::size_t bucket_count = 0;
+
+  for (std::size_t hi = 0; hi < rows.size(); ++hi)
+  {
+    if (rows[hi] == 0)
+    {
+      continue;
+    }
+
+    std::size_t bucket = 0;
+
+    while (bucket < bucket_count && buckets[bucket] != rows[hi])
+    {
+      ++bucket;
+    }
+
+    if (bucket == bucket_count)
+    {
+      if (bucket_count == buckets.size())
+      {
+        nibbles_exact_ = false;
+        return;
+      }
+
+      buckets[bucket_count++] = rows[hi];
+    }
+
+    auto const bit = static_cast<uint8_t>(1U << bucket);
+
+    hi_nibbles_[hi] = bit;
+
+    for (std::size_t lo = 0; lo < 16; ++lo)
+    {
+      if ((rows[hi] >> lo) & 1U)
+      {
+        lo_nibbles_[lo] |= bit;
+      }
+    }
+  }
+}
+
+
+////////////////////////////////////////////////////////////
+// A lazy forward range over the segments of the input, yielding std::string_views into it rather than allocating a std::string per segment
+class split_view
+{
+public:
+  class iterator
+  {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::string_view;
+    using difference_type = std::ptrdiff_t;
+    using pointer = std::string_view const *;
+    using reference = std::string_view const &;
+
+    iterator() = default;
+
+    auto operator*() const noexcept -> reference { return segment_; }
+    auto operator->() const noexcept -> pointer { return &segment_; }
+
+    auto operator++() -> iterator &;
+    auto operator++(int) -> iterator;
+
+    friend auto operator==(iterator const &lhs, iterator const &rhs) noexcept -> bool
+    {
+      return lhs.done_ == rhs.done_ && (lhs.done_ || lhs.segment_.data() == rhs.segment_.data());
+    }
+
+    friend auto operator!=(iterator const &lhs, iterator const &rhs) noexcept -> bool { return !(lhs == rhs); }
+
+  private:
+    friend class split_view;
+
+    split_view const *parent_ = nullptr;
+    std::string_view segment_{};
+    char const *next_ = nullptr; // Start of the next segment to scan, or nullptr once the input is exhausted
+    bool first_ = true;
+    bool done_ = true;
+  };
+
+  split_view(std::string_view input, char delimiter, bool collapse_adjacent_delimiters = true, bool ignore_leading_delimiter = true) noexcept;
+  split_view(std::string_view input, std::string_view delimiters, bool collapse_adjacent_delimiters = true, bool ignore_leading_delimiter = true) noexcept;
+  split_view(std::string_view input, std::string_view delimiters, delimiter_mode mode, bool collapse_adjacent_delimiters = true, bool ignore_leading_delimiter = true);
+
+  auto begin() const -> iterator;
+  auto end() const noexcept -> iterator { return iterator{}; }
+
+private:
+  auto find_delimiter(char const *first) const noexcept -> char const *;
+  void advance(iterator &it) const;
+
+  std::string_view input_;
+  byte_class delimiters_;
+  std::string sequence_; // Only used for multi-char delimiters, and copied so that it can't dangle, as delimiters_ can't either
+  std::size_t delimiter_length_ = 1;
+  char delimiter_ = '\0';
+  bool single_delimiter_ = true;
+  bool collapse_adjacent_delimiters_ = true;
+  bool ignore_leading_delimiter_ = true;
+};
 
 auto split(std::string_view input, char delimiter, bool collapse_adjacent_delimiters = true, bool ignore_leading_delimiter = true) -> std::vector<std::string>;
 auto split(std::string_view input, std::string_view delimiters, bool collapse_adjacent_delimiters = true, bool ignore_leading_delimiter = true) -> std::vector<std::string>;
+auto split(std::string_view input, std::string_view delimiters, delimiter_mode mode, bool collapse_adjacent_delimiters = true, bool ignore_leading_delimiter = true) -> std::vector<std::string>;
+
+auto split_into(std::vector<std::string_view> &output, std::string_view input, char delimiter, bool collapse_adjacent_delimiters = true, bool ignore_leading_delimiter = true) -> void;
+auto split_into(std::vector<std::string_view> &output, std::string_view input, std::string_view delimiters, bool collapse_adjacent_delimiters = true, bool ignore_leading_delimiter = true) -> void;
+auto split_into(std::vector<std::string_view> &output, std::string_view input, std::string_view delimiters, delimiter_mode mode, bool collapse_adjacent_delimiters = true, bool ignore_leading_delimiter = true) -> void;
+
+// Returns [begin, end) offsets into the input rather than strings. A thread_count of 0 picks one based on the hardware and the input size
+auto split_parallel(std::string_view input, char delimiter, bool collapse_adjacent_delimiters = true, bool ignore_leading_delimiter = true, std::size_t thread_count = 0) -> std::vector<std::pair<std::size_t, std::size_t>>;
+
+////////////////////////////////////////////////////////////
+// A read-only view of a whole file. Where the platform supports it the file is memory mapped, otherwise it is read into memory in one go
+class mapped_file
+{
+public:
+  mapped_file() = default;
+  explicit mapped_file(std::string const &path, bool sequential = true); // sequential hints to the OS that the file will be read from start to end
+  ~mapped_file();
+
+  mapped_file(mapped_file &&other) noexcept;
+  auto operator=(mapped_file &&other) noexcept -> mapped_file &;
+
+  mapped_file(mapped_file const &) = delete;
+  auto operator=(mapped_file const &) -> mapped_file & = delete;
+
+  auto data() const noexcept -> char const * { return data_; }
+  auto size() const noexcept -> std::size_t { return size_; }
+  auto view() const noexcept -> std::string_view { return {data_, size_}; }
+
+private:
+  char const *data_ = nullptr;
+  std::size_t size_ = 0;
+  bool mapped_ = false;
+  std::unique_ptr<char[]> buffer_; // Only used when the file couldn't be memory mapped
+};
+
+
+////////////////////////////////////////////////////////////
+// Reads a file (or any other buffer) one line at a time, yielding std::string_views into it. Lines end at \n or \r\n, which aren't included in
+// the line, and a trailing newline at the end of the input doesn't produce an extra empty line
+class line_reader
+{
+public:
+  class iterator
+  {
+  public:
+    using iterator_category = std::input_iterator_tag;
+    using value_type = std::string_view;
+    using difference_type = std::ptrdiff_t;
+    using pointer = std::string_view const *;
+    using reference = std::string_view const &;
+
+    iterator() = default;
+
+    auto operator*() const noexcept -> reference { return line_; }
+    auto operator->() const noexcept -> pointer { return &line_; }
+
+    auto operator++() noexcept -> iterator &;
+    auto operator++(int) noexcept -> iterator;
+
+    friend auto operator==(iterator const &lhs, iterator const &rhs) noexcept -> bool { return lhs.reader_ == rhs.reader_; }
+    friend auto operator!=(iterator const &lhs, iterator const &rhs) noexcept -> bool { return !(lhs == rhs); }
+
+  private:
+    friend class line_reader;
+
+    line_reader *reader_ = nullptr; // Null once there are no more lines
+    std::string_view line_;
+  };
+
+  explicit line_reader(mapped_file file) noexcept;
+  explicit line_reader(std::string_view input) noexcept; // The input must outlive the reader
+
+  auto next(std::string_view &line) noexcept -> bool; // Returns false once there are no more lines
+
+  // Single pass - the iterators share the reader's position, so begin() continues from wherever the last line left off
+  auto begin() noexcept -> iterator;
+  auto end() noexcept -> iterator { return iterator{}; }
+
+private:
+  mapped_file file_;
+  std::string_view input_;
+
+  char const *pos_ = nullptr;   // Start of the next line
+  char const *scan_ = nullptr;  // Start of the next block to search for newlines
+  char const *block_ = nullptr; // Start of the block that mask_ refers to
+  uint64_t mask_ = 0;           // Newlines found in the current block but not yet consumed, one bit per byte
+};
+
+////////////////////////////////////////////////////////////
+// Parses CSV (or TSV, etc.) data with quoted fields into std::string_views into the input. Quoted fields have their surrounding quotes removed,
+// but any doubled quotes inside them are left as they are - use csv_unquote() to collapse those. Rows end at \n or \r\n, and blank rows are skipped
+class csv_parser
+{
+public:
+  class row
+  {
+  public:
+    auto begin() const noexcept -> std::string_view const * { return first_; }
+    auto end() const noexcept -> std::string_view const * { return last_; }
+    auto size() const noexcept -> std::size_t { return static_cast<std::size_t>(last_ - first_); }
+    auto operator[](std::size_t index) const noexcept -> std::string_view { return first_[index]; }
+
+  private:
+    friend class csv_parser;
+
+    row(std::string_view const *first, std::string_view const *last) noexcept : first_(first), last_(last) {}
+
+    std::string_view const *first_;
+    std::string_view const *last_;
+  };
+
+  explicit csv_parser(char delimiter = ',', char quote = '"') noexcept;
+
+  // Parses the input, replacing any rows from a previous call, and returns the number of bytes consumed. For streaming, pass last_chunk = false
+  // for all but the final chunk of data - the trailing partial row is then left unconsumed, to be passed in again at the start of the next chunk
+  auto parse(std::string_view input, bool last_chunk = true) -> std::size_t;
+
+  auto size() const noexcept -> std::size_t { return row_starts_.size() - 1; }
+  auto operator[](std::size_t index) const noexcept -> row { return row{fields_.data() + row_starts_[index], fields_.data() + row_starts_[index + 1]}; }
+
+private:
+  auto find_structurals(std::string_view input) -> bool;
+  auto end_row(bool blank_line) -> void; // Blank lines are dropped rather than becoming rows
+
+  char delimiter_;
+  char quote_;
+
+  std::vector<std::size_t> structurals_;   // Positions of every delimiter and newline that isn't inside quotes
+  std::vector<std::string_view> fields_;   // Every field of every row, one row after another
+  std::vector<std::size_t> row_starts_{0}; // Index of the first field of each row, plus one past the last field of the last row
+};
+
+auto csv_unquote(std::string_view field, char quote = '"') -> std::string;
+
+////////////////////////////////////////////////////////////
+// The inverse of split - the total size is worked out first, so the output is only allocated once. The range can hold anything that converts
+// to a std::string_view
+template<typename Range>
+auto join(Range const &range, std::string_view separator) -> std::string
+{
+  std::size_t size = 0;
+  std::size_t count = 0;
+
+  for (auto const &item : range)
+  {
+    size += std::string_view{item}.size();
+    ++count;
+  }
+
+  if (count > 1)
+  {
+    size += separator.size() * (count - 1);
+  }
+
+  auto output = std::string{};
+  output.reserve(size);
+
+  auto first = true;
+
+  for (auto const &item : range)
+  {
+    if (!first)
+    {
+      output.append(separator);
+    }
+
+    output.append(std::string_view{item});
+    first = false;
+  }
+
+  return output;
+}
+
+inline auto join(std::initializer_list<std::string_view> items, std::string_view separator) -> std::string
+{
+  return join<std::initializer_list<std::string_view>>(items, separator);
+}
+
+
+////////////////////////////////////////////////////////////
+// An append-only string buffer for assembling output in place, without building an intermediate std::string for each piece of it
+class builder
+{
+public:
+  builder() = default;
+  explicit builder(std::size_t capacity) { buffer_.reserve(capacity); }
+
+  auto reserve(std::size_t capacity) -> builder &
+  {
+    buffer_.reserve(capacity);
+    return *this;
+  }
+
+  auto append(std::string_view input) -> builder &
+  {
+    buffer_.append(input);
+    return *this;
+  }
+
+  auto append(char c) -> builder &
+  {
+    buffer_.push_back(c);
+    return *this;
+  }
+
+  auto append(std::size_t count, char c) -> builder &;
+
+  // Appends each byte as two uppercase hex digits, optionally with a space between each pair, like hmr::hex::encode()
+  auto append_hex(std::string_view input, bool delimited = false) -> builder &;
+
+  // Appends the value as exactly two hex digits per byte, e.g. 8 digits for a uint32_t
+  template<typename T, typename = std::enable_if_t<std::is_integral_v<T>>>
+  auto append_hex(T value) -> builder &
+  {
+    constexpr auto digits = "0123456789ABCDEF";
+    constexpr auto width = sizeof(T) * 2;
+
+    auto *out = grow(width);
+    auto bits = static_cast<std::make_unsigned_t<T>>(value);
+
+    for (std::size_t i = width; i > 0; --i)
+    {
+      out[i - 1] = digits[bits & 0x0F];
+      bits = static_cast<std::make_unsigned_t<T>>(bits >> 4);
+    }
+
+    return *this;
+  }
+
+  // Appends the value in decimal
+  template<typename T, typename = std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>>
+  auto append_int(T value) -> builder &
+  {
+    char digits[std::numeric_limits<T>::digits10 + 2];
+    auto const result = std::to_chars(std::begin(digits), std::end(digits), value);
+
+    return append(std::string_view{digits, static_cast<std::size_t>(result.ptr - digits)});
+  }
+
+  auto append_escaped(std::string_view input, escape_mode mode = escape_mode::standard) -> builder &;
+
+  auto size() const noexcept -> std::size_t { return buffer_.size(); }
+  auto view() const noexcept -> std::string_view { return buffer_; }
+  auto clear() noexcept -> void { buffer_.clear(); }
+
+  auto str() const & -> std::string { return buffer_; }
+  auto str() && -> std::string { return std::move(buffer_); }
+
+private:
+  auto grow(std::size_t count) -> char *; // Extends the buffer by count chars, returning a pointer to the first of them
+
+  std::string buffer_;
+};
+
+////////////////////////////////////////////////////////////
+// Parses the whole of the input as a number, returning false (and leaving value untouched) if it isn't one. Unlike std::stoi(), std::stod(),
+// etc., this never depends on the current locale, and never allocates
+template<typename T, typename = std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>>
+auto try_parse(std::string_view input, T &value) noexcept -> bool
+{
+  // Like std::stoi(), allow an explicit plus sign, which std::from_chars() doesn't
+  if (input.size() > 1 && input[0] == '+' && input[1] != '-')
+  {
+    input.remove_prefix(1);
+  }
+
+  auto parsed = T{};
+  auto const *last = input.data() + input.size();
+  auto const result = std::from_chars(input.data(), last, parsed);
+
+  if (result.ec != std::errc{} || result.ptr != last)
+  {
+    return false;
+  }
+
+  value = parsed;
+  return true;
+}
+
+auto try_parse(std::string_view input, float &value) noexcept -> bool;
+auto try_parse(std::string_view input, double &value) noexcept -> bool;
+auto try_parse(std::string_view input, long double &value) noexcept -> bool;
+
+// As try_parse(), but throws if the input isn't a valid T
+template<typename T>
+auto parse(std::string_view input) -> T
+{
+  auto value = T{};
+
+  if (!try_parse(input, value))
+  {
+    throw hmr::xcpt::format::invalid_input("Could not parse \"" + std::string{input} + "\" as a number!");
+  }
+
+  return value;
+}
+
+// Parses a run of ASCII digits (up to 19 of them, with no sign) 8 digits at a time, e.g. for fixed-width fields such as timestamps
+auto parse_digits(std::string_view digits, uint64_t &value) noexcept -> bool;
+
+// Parses every field of a column in one go, throwing if any of them isn't a valid T. The output is resized to match the number of fields
+template<typename T, typename Range>
+auto parse_column(Range const &fields, std::vector<T> &output) -> void
+{
+  output.clear();
+
+  for (auto const &item : fields)
+  {
+    auto const field = std::string_view{item};
+    auto value = T{};
+
+    // Plain runs of digits take the fast path, while anything else (signs, floating point, etc.) goes through try_parse()
+    if constexpr (std::is_integral_v<T>)
+    {
+      uint64_t digits = 0;
+
+      if (parse_digits(field, digits) && digits <= static_cast<uint64_t>(std::numeric_limits<T>::max()))
+      {
+        output.push_back(static_cast<T>(digits));
+        continue;
+      }
+    }
+
+    if (!try_parse(field, value))
+    {
+      throw hmr::xcpt::format::invalid_input("Could not parse \"" + std::string{field} + "\" as a number!");
+    }
+
+    output.push_back(value);
+  }
+}
+
+template<typename T, typename Range>
+auto parse_column(Range const &fields) -> std::vector<T>
+{
+  auto output = std::vector<T>{};
+  parse_column(fields, output);
+
+  return output;
+}
+
+// Writes the shortest representation of the value that parses back to the same value into [first, last), returning one past the last char
+// written, or nullptr if it didn't fit
+template<typename T, typename = std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool>>>
+auto format_into(char *first, char *last, T value) noexcept -> char *
+{
+  auto const result = std::to_chars(first, last, value);
+  return (result.ec == std::errc{}) ? result.ptr : nullptr;
+}
+
+auto format_into(char *first, char *last, float value) noexcept -> char *;
+auto format_into(char *first, char *last, double value) noexcept -> char *;
+auto format_into(char *first, char *last, long double value) noexcept -> char *;
+
+// Appends the value to the output
+template<typename T, typename = std::enable_if_t<std::is_arithmetic_v<T> && !std::is_same_v<T, bool>>>
+auto format_into(std::string &output, T value) -> void
+{
+  char buffer[64]; // Enough for any integral type, and the shortest round-trip representation of any floating point type
+  auto const *end = format_into(std::begin(buffer), std::end(buffer), value);
+
+  output.append(buffer, static_cast<std::size_t>(end - buffer));
+}
 
 auto lstrip(std::string_view input, std::string_view any_of_these = " \n\r\t\f\v"sv) -> std::string_view;
 auto rstrip(std::string_view input, std::string_view any_of_these = " \n\r\t\f\v"sv) -> std::string_view;
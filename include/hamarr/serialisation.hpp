@@ -1,8 +1,28 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
 #include <map>
+#include <memory>
+#include <ostream>
 #include <string>
 #include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "format.hpp"
+
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#endif
 
 
 namespace hmr::kvp
@@ -11,9 +31,501 @@ namespace hmr::kvp
 using kvps = std::map<std::string, std::string>;
 
 ////////////////////////////////////////////////////////////
-auto serialise(kvps const &input, char kv_delimiter = '=', char kvp_delimiter = '&') -> std::string;
+// A vector that stores up to N elements inline, only allocating once it grows beyond that. Elements are never destroyed individually, so it's
+// limited to trivially destructible types
+template<typename T, std::size_t N>
+class small_vector
+{
+  static_assert(std::is_trivially_destructible_v<T>, "small_vector only supports trivially destructible types");
+
+public:
+  using value_type = T;
+  using size_type = std::size_t;
+  using iterator = T *;
+  using const_iterator = T const *;
+
+  small_vector() = default;
+
+  small_vector(small_vector const &other) { assign(other); }
+
+  small_vector(small_vector &&other) noexcept { take(other); }
+
+  auto operator=(small_vector const &other) -> small_vector &
+  {
+    if (this != &other)
+    {
+      clear();
+      assign(other);
+    }
+
+    return *this;
+  }
+
+  auto operator=(small_vector &&other) noexcept -> small_vector &
+  {
+    if (this != &other)
+    {
+      heap_.reset();
+      data_ = inline_.data();
+      capacity_ = N;
+      take(other);
+    }
+
+    return *this;
+  }
+
+  auto push_back(T const &value) -> void
+  {
+    if (size_ == capacity_)
+    {
+      reserve(capacity_ * 2);
+    }
+
+    data_[size_++] = value;
+  }
+
+  template<typename... Args>
+  auto emplace_back(Args &&...args) -> T &
+  {
+    push_back(T{std::forward<Args>(args)...});
+    return data_[size_ - 1];
+  }
+
+  auto reserve(size_type capacity) -> void
+  {
+    if (capacity <= capacity_)
+    {
+      return;
+    }
+
+    auto grown = std::make_unique<T[]>(capacity);
+    std::copy(data_, data_ + size_, grown.get());
+
+    heap_ = std::move(grown);
+    data_ = heap_.get();
+    capacity_ = capacity;
+  }
+
+  auto clear() noexcept -> void { size_ = 0; }
+
+  auto size() const noexcept -> size_type { return size_; }
+  auto capacity() const noexcept -> size_type { return capacity_; }
+  auto empty() const noexcept -> bool { return size_ == 0; }
+  auto is_inline() const noexcept -> bool { return data_ == inline_.data(); } // True if nothing has been allocated
+
+  auto data() noexcept -> T * { return data_; }
+  auto data() const noexcept -> T const * { return data_; }
+
+  auto operator[](size_type index) noexcept -> T & { return data_[index]; }
+  auto operator[](size_type index) const noexcept -> T const & { return data_[index]; }
+
+  auto begin() noexcept -> iterator { return data_; }
+  auto end() noexcept -> iterator { return data_ + size_; }
+  auto begin() const noexcept -> const_iterator { return data_; }
+  auto end() const noexcept -> const_iterator { return data_ + size_; }
+
+  friend auto operator==(small_vector const &lhs, small_vector const &rhs) -> bool { return std::equal(lhs.begin(), lhs.end(), rhs.begin(), rhs.end()); }
+  friend auto operator!=(small_vector const &lhs, small_vector const &rhs) -> bool { return !(lhs == rhs); }
+
+private:
+  auto assign(small_vector const &other) -> void
+  {
+    reserve(other.size_);
+    std::copy(other.begin(), other.end(), data_);
+    size_ = other.size_;
+  }
+
+  // Steals other's heap buffer if it has one, otherwise copies its inline elements - either way, other is left empty
+  auto take(small_vector &other) noexcept -> void
+  {
+    if (other.is_inline())
+    {
+      std::copy(other.begin(), other.end(), inline_.data());
+    } else
+    {
+      heap_ = std::move(other.heap_);
+      data_ = heap_.get();
+      capacity_ = other.capacity_;
+    }
+
+    size_ = other.size_;
+
+    other.data_ = other.inline_.data();
+    other.capacity_ = N;
+    other.size_ = 0;
+  }
+
+  std::array<T, N> inline_{};
+  std::unique_ptr<T[]> heap_;
+  T *data_ = inline_.data();
+  size_type size_ = 0;
+  size_type capacity_ = N;
+};
+
+
+// Key-value pairs as views into the input they were parsed from, in the order they appear in it
+using kvp_views = small_vector<std::pair<std::string_view, std::string_view>, 16>;
+
+
+////////////////////////////////////////////////////////////
+// A map of key-value pairs stored as a single vector sorted by key, which is far more compact and cache-friendly than a node per pair. Lookups
+// take a std::string_view, so they never need a temporary std::string. Best suited to maps that are built once and then only read. Changing a
+// key would break the ordering, so iteration is read-only, like the keys of a std::map - values are changed through at() and operator[]
+class flat_kvps
+{
+public:
+  using value_type = std::pair<std::string, std::string>;
+  using iterator = std::vector<value_type>::const_iterator;
+  using const_iterator = std::vector<value_type>::const_iterator;
+
+  flat_kvps() = default;
+  explicit flat_kvps(kvp_views const &views); // Where a key appears more than once, the last value wins
+
+  auto find(std::string_view key) const noexcept -> const_iterator;
+  auto contains(std::string_view key) const noexcept -> bool { return find(key) != end(); }
+  auto count(std::string_view key) const noexcept -> std::size_t { return contains(key) ? 1 : 0; }
+
+  // Both throw std::out_of_range if the key isn't present
+  auto at(std::string_view key) -> std::string &;
+  auto at(std::string_view key) const -> std::string const &;
+
+  auto operator[](std::string_view key) -> std::string &;
+
+  auto insert_or_assign(std::string_view key, std::string_view value) -> void;
+
+  auto size() const noexcept -> std::size_t { return items_.size(); }
+  auto empty() const noexcept -> bool { return items_.empty(); }
+  auto clear() noexcept -> void { items_.clear(); }
+
+  auto begin() const noexcept -> const_iterator { return items_.begin(); }
+  auto end() const noexcept -> const_iterator { return items_.end(); }
+
+  friend auto operator==(flat_kvps const &lhs, flat_kvps const &rhs) -> bool { return lhs.items_ == rhs.items_; }
+  friend auto operator!=(flat_kvps const &lhs, flat_kvps const &rhs) -> bool { return !(lhs == rhs); }
+
+private:
+  std::vector<value_type> items_;
+};
+
+
+#if __has_include(<memory_resource>)
+// A std::map whose strings and nodes all come from a std::pmr::memory_resource, e.g. a std::pmr::monotonic_buffer_resource, with transparent
+// lookups by std::string_view
+using pmr_kvps = std::pmr::map<std::pmr::string, std::pmr::string, std::less<>>;
+#endif
+
+
+////////////////////////////////////////////////////////////
+// A fixed set of keys, stored in a perfect hash table so that checking whether a key is in the set costs one hash and at most one comparison. The
+// table is built by hash-and-displace: keys are hashed into small buckets, and each bucket gets its own seed that moves all of its keys into
+// free slots. That takes expected linear time and O(n) space: besides the keys themselves, the table is 8 to 16 bytes per key and the seeds 2 to 4
+class key_filter
+{
+public:
+  static constexpr auto npos = static_cast<std::size_t>(-1);
+
+  key_filter(std::initializer_list<std::string_view> keys);
+  explicit key_filter(std::vector<std::string_view> const &keys);
+
+  auto index_of(std::string_view key) const noexcept -> std::size_t; // The key's position in the set (duplicates removed), or npos if it isn't in it
+  auto contains(std::string_view key) const noexcept -> bool { return index_of(key) != npos; }
+  auto size() const noexcept -> std::size_t { return keys_.size(); }
+  auto table_size() const noexcept -> std::size_t { return slots_.size(); }
+
+private:
+  auto hash_of(std::string_view key) const noexcept -> std::uint64_t;
+  auto slot_of(std::uint64_t hash, std::uint32_t seed) const noexcept -> std::size_t;
+  auto try_build() -> bool;
+
+  std::vector<std::string> keys_;
+  std::vector<std::uint32_t> slots_; // One-based indices into keys_, with 0 marking an empty slot
+  std::vector<std::uint32_t> seeds_; // One per bucket
+  std::uint64_t seed_ = 0;           // Seeds the key hash, and only changes if two keys' hashes can't be told apart
+};
+
+
+////////////////////////////////////////////////////////////
+// Many sets of key-value pairs stored by column: each distinct key is stored once, alongside a column holding its value in every row. A row
+// without that key has an empty value, which is otherwise impossible. The values are views into the inputs, so they must outlive the table
+class kvp_table
+{
+public:
+  static constexpr auto npos = static_cast<std::size_t>(-1);
+
+  auto rows() const noexcept -> std::size_t { return rows_; }
+  auto columns() const noexcept -> std::size_t { return keys_.size(); }
+
+  auto keys() const noexcept -> std::vector<std::string> const & { return keys_; } // In the order they were first seen
+  auto column_index(std::string_view key) const noexcept -> std::size_t; // npos if no row has the key
+
+  auto column(std::size_t index) const -> std::vector<std::string_view> const & { return columns_.at(index); }
+  auto column(std::string_view key) const -> std::vector<std::string_view> const &; // Throws std::out_of_range if no row has the key
+
+private:
+  friend auto parse_batch(std::vector<std::string_view> const &inputs, char kv_delimiter, char kvp_delimiter) -> kvp_table;
+
+  auto add_column(std::string_view key) -> std::size_t;
+
+  std::vector<std::string> keys_;
+  std::map<std::string, std::size_t, std::less<>> index_;
+  std::vector<std::vector<std::string_view>> columns_;
+  std::size_t rows_ = 0;
+};
+
+
+////////////////////////////////////////////////////////////
+// Stores each distinct string once, handing out handles to it. Handles to the same string from the same pool always compare equal, so comparing
+// or hashing them is a pointer comparison or hash rather than a string one. Handles stay valid for as long as the pool does. Not thread-safe
+class intern_pool
+{
+public:
+  class handle
+  {
+  public:
+    struct hash
+    {
+      auto operator()(handle h) const noexcept -> std::size_t { return std::hash<std::string const *>{}(h.string_); }
+    };
+
+    handle() = default; // A null handle, which matches no string
+
+    auto view() const noexcept -> std::string_view { return string_ ? std::string_view{*string_} : std::string_view{}; }
+    auto empty() const noexcept -> bool { return string_ == nullptr; }
+
+    // Ordering is by address rather than alphabetical, but is consistent for as long as the pool lives
+    friend auto operator==(handle lhs, handle rhs) noexcept -> bool { return lhs.string_ == rhs.string_; }
+    friend auto operator!=(handle lhs, handle rhs) noexcept -> bool { return lhs.string_ != rhs.string_; }
+    friend auto operator<(handle lhs, handle rhs) noexcept -> bool { return std::less<std::string const *>{}(lhs.string_, rhs.string_); }
+
+  private:
+    friend class intern_pool;
+
+    explicit handle(std::string const *string) noexcept : string_(string) {}
+
+    std::string const *string_ = nullptr;
+  };
+
+  intern_pool() = default;
+  intern_pool(intern_pool const &) = delete;
+  intern_pool(intern_pool &&) = default; // Moving keeps the strings where they are, so existing handles remain valid
+  auto operator=(intern_pool const &) -> intern_pool & = delete;
+  auto operator=(intern_pool &&) -> intern_pool & = default;
+
+  auto intern(std::string_view string) -> handle;
+  auto find(std::string_view string) const noexcept -> handle; // A null handle if the string hasn't been interned
+
+  auto size() const noexcept -> std::size_t { return strings_.size(); }
+
+private:
+  std::deque<std::string> strings_; // A deque never moves its elements, so the handles and the index's views stay valid as it grows
+  std::unordered_map<std::string_view, std::string const *> index_;
+};
+
+
+// Key-value pairs whose keys are interned, so looking a key up hashes and compares pointers
+using interned_kvps = std::unordered_map<intern_pool::handle, std::string, intern_pool::handle::hash>;
+
+
+////////////////////////////////////////////////////////////
+// A read-only view of key-value pairs in the binary format written by serialise_binary(), e.g. straight out of a hmr::fmt::mapped_file. Nothing
+// is copied - the keys and values are views into the input, so it must outlive this. Lookups are a binary search if the input has an index,
+// otherwise a scan. A malformed input throws hmr::xcpt::kvp::parse_error, either when constructed or when the bad pair is reached
+class binary_view
+{
+public:
+  class iterator
+  {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = std::pair<std::string_view, std::string_view>;
+    using difference_type = std::ptrdiff_t;
+    using pointer = value_type const *;
+    using reference = value_type const &;
+
+    iterator() = default;
+
+    auto operator*() const noexcept -> reference { return pair_; }
+    auto operator->() const noexcept -> pointer { return &pair_; }
+
+    auto operator++() -> iterator &;
+    auto operator++(int) -> iterator;
+
+    friend auto operator==(iterator const &lhs, iterator const &rhs) noexcept -> bool
+    {
+      return lhs.remaining_ == rhs.remaining_ && (lhs.remaining_ == 0 || lhs.pair_.first.data() == rhs.pair_.first.data());
+    }
+
+    friend auto operator!=(iterator const &lhs, iterator const &rhs) noexcept -> bool { return !(lhs == rhs); }
+
+  private:
+    friend class binary_view;
+
+    iterator(char const *first, char const *last, std::size_t remaining);
+    auto decode() -> void;
+
+    value_type pair_{};
+    char const *next_ = nullptr;
+    char const *last_ = nullptr;
+    std::size_t remaining_ = 0; // Including the current pair, so 0 only at the end
+  };
+
+  explicit binary_view(std::string_view input);
+
+  auto size() const noexcept -> std::size_t { return count_; }
+  auto empty() const noexcept -> bool { return count_ == 0; }
+  auto indexed() const noexcept -> bool { return index_ != nullptr; }
+
+  auto begin() const -> iterator { return iterator{records_, last_, count_}; }
+  auto end() const noexcept -> iterator { return iterator{}; }
+
+  auto find(std::string_view key) const -> iterator;
+  auto contains(std::string_view key) const -> bool { return find(key) != end(); }
+  auto at(std::string_view key) const -> std::string_view; // Throws std::out_of_range if the key isn't present
+
+private:
+  auto pair_at(std::size_t index) const -> iterator;
+
+  char const *records_ = nullptr;
+  char const *last_ = nullptr;
+  unsigned char const *index_ = nullptr; // Offsets of each pair from records_, little-endian and offset_width_ bytes each
+  std::size_t offset_width_ = 0;
+  std::size_t count_ = 0;
+};
+
+
+////////////////////////////////////////////////////////////
+// Optionally url-encodes each key and value as it goes, which also makes it safe for them to contain the delimiters
+auto serialise(kvps const &input, char kv_delimiter = '=', char kvp_delimiter = '&', bool url_encode = false) -> std::string;
+
+////////////////////////////////////////////////////////////
+// Streaming variants, which append to the caller's string or write to a stream rather than returning a new string
+auto serialise(kvps const &input, std::string &output, char kv_delimiter = '=', char kvp_delimiter = '&', bool url_encode = false) -> void;
+auto serialise(kvps const &input, std::ostream &output, char kv_delimiter = '=', char kvp_delimiter = '&', bool url_encode = false) -> void;
+
+////////////////////////////////////////////////////////////
+// A compact binary alternative to the text format, which doesn't need parsing to be read: each key and value is prefixed by its length as a
+// varint, in key order. With an index, which costs 4 bytes per pair (8 for outputs over 4 GiB), binary_view can binary search for keys
+auto serialise_binary(kvps const &input, bool with_index = true) -> std::string;
 
 ////////////////////////////////////////////////////////////
 auto deserialise(std::string_view input, char kv_delimiter = '=', char kvp_delimiter = '&') -> kvps;
+auto deserialise_binary(std::string_view input) -> kvps;
+
+////////////////////////////////////////////////////////////
+// Interns every key into the pool, so records parsed with the same pool share a single copy of each key name
+auto deserialise(std::string_view input, intern_pool &pool, char kv_delimiter = '=', char kvp_delimiter = '&') -> interned_kvps;
+
+////////////////////////////////////////////////////////////
+// Deserialises into any map-like container with std::string-like keys and values (e.g. std::unordered_map, hmr::kvp::pmr_kvps), adding to or
+// overwriting whatever it already holds. If the container's strings take its allocator, e.g. with std::pmr containers, they are created with it.
+// Each pair is inserted as soon as it's parsed, so if the input turns out to be malformed the pairs before the error will already have been added
+template<typename Map>
+auto deserialise_into(Map &output, std::string_view input, char kv_delimiter = '=', char kvp_delimiter = '&') -> void;
+
+auto deserialise_into(flat_kvps &output, std::string_view input, char kv_delimiter = '=', char kvp_delimiter = '&') -> void;
+
+////////////////////////////////////////////////////////////
+template<typename Map>
+auto deserialise(std::string_view input, char kv_delimiter = '=', char kvp_delimiter = '&') -> Map
+{
+  auto output = Map{};
+  deserialise_into(output, input, kv_delimiter, kvp_delimiter);
+
+  return output;
+}
+
+////////////////////////////////////////////////////////////
+// Calls callback(key, value) with views into the input for each pair in turn, without building anything, following the same rules as
+// deserialise_view(). The callback can return false to stop early, in which case this returns false. With a key_filter, pairs whose keys aren't
+// in it are skipped
+template<typename Callback>
+auto for_each_pair(std::string_view input, Callback &&callback, char kv_delimiter = '=', char kvp_delimiter = '&') -> bool;
+
+template<typename Callback>
+auto for_each_pair(std::string_view input, key_filter const &filter, Callback &&callback, char kv_delimiter = '=', char kvp_delimiter = '&') -> bool;
+
+////////////////////////////////////////////////////////////
+// Parses many inputs into one table, with a row per input. Records that share the same keys in the same order are the fast path
+auto parse_batch(std::vector<std::string_view> const &inputs, char kv_delimiter = '=', char kvp_delimiter = '&') -> kvp_table;
+
+////////////////////////////////////////////////////////////
+// Splits a single pair around the kv_delimiter, throwing hmr::xcpt::kvp::parse_error unless it holds exactly one non-empty key and value
+auto split_pair(std::string_view pair, char kv_delimiter = '=') -> std::pair<std::string_view, std::string_view>;
+
+////////////////////////////////////////////////////////////
+// As deserialise(), but without copying anything - the views point into the input, so it must outlive them. Duplicate keys are all kept
+auto deserialise_view(std::string_view input, char kv_delimiter = '=', char kvp_delimiter = '&') -> kvp_views;
+
+
+////////////////////////////////////////////////////////////
+template<typename Callback>
+auto for_each_pair(std::string_view input, Callback &&callback, char kv_delimiter, char kvp_delimiter) -> bool
+{
+  for (auto const pair : hmr::fmt::split_view(input, kvp_delimiter))
+  {
+    auto const [key, value] = split_pair(pair, kv_delimiter);
+
+    if constexpr (std::is_same_v<std::invoke_result_t<Callback &, std::string_view, std::string_view>, void>)
+    {
+      callback(key, value);
+    } else
+    {
+      if (!callback(key, value))
+      {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+
+////////////////////////////////////////////////////////////
+template<typename Callback>
+auto for_each_pair(std::string_view input, key_filter const &filter, Callback &&callback, char kv_delimiter, char kvp_delimiter) -> bool
+{
+  return for_each_pair(input, [&filter, &callback](std::string_view key, std::string_view value)
+  {
+    if (!filter.contains(key))
+    {
+      return true;
+    }
+
+    if constexpr (std::is_same_v<std::invoke_result_t<Callback &, std::string_view, std::string_view>, void>)
+    {
+      callback(key, value);
+      return true;
+    } else
+    {
+      return static_cast<bool>(callback(key, value));
+    }
+  }, kv_delimiter, kvp_delimiter);
+}
+
+
+////////////////////////////////////////////////////////////
+template<typename Map>
+auto deserialise_into(Map &output, std::string_view input, char kv_delimiter, char kvp_delimiter) -> void
+{
+  // Create each string with the container's allocator if it uses one, so that the container can take ownership of it without a copy
+  auto make = [&output](auto tag, std::string_view view)
+  {
+    using string_type = typename decltype(tag)::type;
+
+    if constexpr (std::uses_allocator_v<string_type, typename Map::allocator_type>)
+    {
+      return string_type{view, output.get_allocator()};
+    } else
+    {
+      return string_type{view};
+    }
+  };
+
+  for_each_pair(input, [&output, &make](std::string_view key, std::string_view value)
+  {
+    output.insert_or_assign(make(std::common_type<typename Map::key_type>{}, key), make(std::common_type<typename Map::mapped_type>{}, value));
+  }, kv_delimiter, kvp_delimiter);
+}
 
 } // namespace hmr::kvp
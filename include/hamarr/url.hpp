@@ -1,7 +1,11 @@
 #pragma once
 
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <string_view>
+#include <utility>
+#include <vector>
 
 
 namespace hmr::url
@@ -14,7 +18,38 @@ constexpr auto unreserved_chars = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrs
 ////////////////////////////////////////////////////////////
 auto encode(std::string_view input, bool lazy = false) noexcept -> std::string;
 
+////////////////////////////////////////////////////////////
+// The exact length of the input once encoded, and encoding into a caller's buffer that has room for that many chars (returning a pointer one
+// past the last char written), for building encoded output without intermediate strings
+auto encoded_size(std::string_view input, bool lazy = false) noexcept -> std::size_t;
+auto encode_into(std::string_view input, char *output, bool lazy = false) noexcept -> char *;
+
 ////////////////////////////////////////////////////////////
 auto decode(std::string_view input, bool lazy = false) -> std::string;
 
+
+////////////////////////////////////////////////////////////
+struct query
+{
+  std::unique_ptr<char[]> arena;                                    // Holds every decoded key and value
+  std::vector<std::pair<std::string_view, std::string_view>> pairs; // Views into the arena, in the order they appeared in the input
+};
+
+////////////////////////////////////////////////////////////
+auto parse_query(std::string_view input, char kv_delimiter = '=', char kvp_delimiter = '&', bool lazy = false) -> query;
+
+
+////////////////////////////////////////////////////////////
+struct canonical_url
+{
+  std::size_t size; // Number of chars written to the output buffer
+  uint64_t hash;    // 64-bit FNV-1a hash of the canonical form
+};
+
+////////////////////////////////////////////////////////////
+auto canonicalise(std::string_view input, char *output) noexcept -> canonical_url; // The output buffer must have room for at least input.size() chars
+
+////////////////////////////////////////////////////////////
+auto canonicalise(std::string_view input, std::string &output) -> uint64_t;
+
 } // namespace hmr::url
@@ -1,266 +1,736 @@
 #include "hamarr/bitwise.hpp"
 
 #include <algorithm>
+#include <array>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "hamarr/exceptions.hpp"
+
+#include "simd.hpp"
+#include "parallel.hpp"
 
 namespace hmr::bitwise
 {
 
 static constexpr std::size_t bits_per_byte = 8;
 
+namespace
+{
+
+// Keys shorter than this are expanded into a stack buffer by xor_repeating, and longer ones are used as they are
+constexpr std::size_t max_expanded_key = 64;
+
+
 ////////////////////////////////////////////////////////////
-auto xor_with_key(std::string_view input, std::string_view key) noexcept -> std::string
+// XORs len bytes from first with len bytes from key into out, which can be first to work in place
+auto xor_bytes(char const *first, char const *key, std::size_t len, char *out) noexcept -> void
 {
-  auto output = std::string{};
-  output.reserve(input.size());
+  auto const *last = first + len;
 
-  auto const len = input.size();
+#if defined(HMR_SIMD_AVX2)
+  for (; last - first >= 32; first += 32, key += 32, out += 32)
+  {
+    auto const block = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(first));
+    auto const key_block = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(key));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), _mm256_xor_si256(block, key_block));
+  }
+#endif
 
-  for (std::size_t i = 0; i < len; ++i)
+#if defined(HMR_SIMD_SSE2)
+  for (; last - first >= 16; first += 16, key += 16, out += 16)
   {
-    output.push_back(static_cast<uint8_t>(input[i]) ^ static_cast<uint8_t>(key[i % key.size()]));
+    auto const block = _mm_loadu_si128(reinterpret_cast<__m128i const *>(first));
+    auto const key_block = _mm_loadu_si128(reinterpret_cast<__m128i const *>(key));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_xor_si128(block, key_block));
   }
+#endif
 
-  return output;
+  for (; last - first >= 8; first += 8, key += 8, out += 8)
+  {
+    uint64_t block = 0;
+    uint64_t key_block = 0;
+    std::memcpy(&block, first, 8);
+    std::memcpy(&key_block, key, 8);
+
+    block ^= key_block;
+    std::memcpy(out, &block, 8);
+  }
+
+  for (; first != last; ++first, ++key, ++out)
+  {
+    *out = static_cast<char>(*first ^ *key);
+  }
 }
 
 
 ////////////////////////////////////////////////////////////
-auto xor_with_key(std::string_view input, uint8_t key) noexcept -> std::string
+// XORs [first, last) with a single byte into out, which can be first to work in place, broadcasting the byte across each vector
+auto xor_byte(char const *first, char const *last, char key, char *out) noexcept -> void
 {
-  auto output = std::string{};
-  output.reserve(input.size());
+#if defined(HMR_SIMD_AVX2)
+  auto const key_256 = _mm256_set1_epi8(key);
 
-  std::transform(std::begin(input), std::end(input), std::back_inserter(output), [&key](uint8_t const &ch)
-    { return (ch ^ key); });
+  for (; last - first >= 32; first += 32, out += 32)
+  {
+    auto const block = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(first));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), _mm256_xor_si256(block, key_256));
+  }
+#endif
 
-  return output;
+#if defined(HMR_SIMD_SSE2)
+  auto const key_128 = _mm_set1_epi8(key);
+
+  for (; last - first >= 16; first += 16, out += 16)
+  {
+    auto const block = _mm_loadu_si128(reinterpret_cast<__m128i const *>(first));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_xor_si128(block, key_128));
+  }
+#endif
+
+  auto const key_64 = uint64_t{static_cast<uint8_t>(key)} * 0x0101010101010101;
+
+  for (; last - first >= 8; first += 8, out += 8)
+  {
+    uint64_t block = 0;
+    std::memcpy(&block, first, 8);
+
+    block ^= key_64;
+    std::memcpy(out, &block, 8);
+  }
+
+  for (; first != last; ++first, ++out)
+  {
+    *out = static_cast<char>(*first ^ key);
+  }
 }
 
 
 ////////////////////////////////////////////////////////////
-auto xor_rolling(std::string_view input, xor_differential differential) noexcept -> std::string
+// XORs [first, last) with a repeating key into out, which can be first to work in place, without allocating. A single byte key is broadcast,
+// and a key of max_expanded_key bytes or more is XORed a run at a time straight from the key. Anything in between is written out to a stack
+// buffer of key.size() + 31 bytes, so that a whole vector's worth of it can be loaded from any position in the key, then each vector steps that
+// position along by its width. That keeps the cost of the key to one load per vector, rather than a modulo per byte, whatever its length
+auto xor_repeating(char const *first, char const *last, std::string_view key, char *out) noexcept -> void
 {
-  auto output = std::string{};
-  output.reserve(input.size());
-
-  auto const len = input.size();
+  auto const key_size = key.size();
 
-  // Insert the first byte unchanged
-  output.push_back(input[0]);
+  if (key_size == 1)
+  {
+    xor_byte(first, last, key.front(), out);
+    return;
+  }
 
-  // Start the loop on the second byte
-  for (std::size_t i = 1; i < len; ++i)
+  if (key_size >= max_expanded_key)
   {
-    // In input differential mode, XOR each byte with the original pre-XOR value of the previous byte
-    if (differential == xor_differential::input)
+    for (auto position = std::size_t{0}; first != last; position = 0)
     {
-      output.push_back(static_cast<uint8_t>(input[i]) ^ static_cast<uint8_t>(input[i - 1]));
+      auto const run = std::min(static_cast<std::size_t>(last - first), key_size - position);
+      xor_bytes(first, key.data() + position, run, out);
+
+      first += run;
+      out += run;
+    }
+
+    return;
+  }
+
+  auto expanded = std::array<char, max_expanded_key + 31>{};
+
+  for (std::size_t i = 0; i < key_size + 31; ++i)
+  {
+    expanded[i] = key[i % key_size];
+  }
 
-      // In output differential mode, XOR each byte with the resulting post-XOR value of the previous byte
-    } else if (differential == xor_differential::output)
+  auto position = std::size_t{0};
+
+  auto advance = [&position, key_size](std::size_t step)
+  {
+    position += step;
+
+    if (position >= key_size)
     {
-      output.push_back(static_cast<uint8_t>(input[i]) ^ static_cast<uint8_t>(output[i - 1]));
+      position -= key_size;
     }
+  };
+
+#if defined(HMR_SIMD_AVX2)
+  auto const step_256 = std::size_t{32} % key_size;
+
+  for (; last - first >= 32; first += 32, out += 32)
+  {
+    auto const block = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(first));
+    auto const key_block = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(expanded.data() + position));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), _mm256_xor_si256(block, key_block));
+
+    advance(step_256);
   }
+#endif
 
-  return output;
+#if defined(HMR_SIMD_SSE2)
+  auto const step_128 = std::size_t{16} % key_size;
+
+  for (; last - first >= 16; first += 16, out += 16)
+  {
+    auto const block = _mm_loadu_si128(reinterpret_cast<__m128i const *>(first));
+    auto const key_block = _mm_loadu_si128(reinterpret_cast<__m128i const *>(expanded.data() + position));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_xor_si128(block, key_block));
+
+    advance(step_128);
+  }
+#endif
+
+  // Eight bytes at a time as a plain integer, which is all there is without SIMD, and then byte by byte for whatever is left
+  auto const step_64 = std::size_t{8} % key_size;
+
+  for (; last - first >= 8; first += 8, out += 8)
+  {
+    uint64_t block = 0;
+    uint64_t key_block = 0;
+    std::memcpy(&block, first, 8);
+    std::memcpy(&key_block, expanded.data() + position, 8);
+
+    block ^= key_block;
+    std::memcpy(out, &block, 8);
+
+    advance(step_64);
+  }
+
+  for (; first != last; ++first, ++out)
+  {
+    *out = static_cast<char>(*first ^ expanded[position]);
+    advance(1);
+  }
 }
 
 
 ////////////////////////////////////////////////////////////
-auto xor_counter(std::string_view input, uint8_t key, int increment) noexcept -> std::string
+// Replaces each byte x with (x << left) | (x >> right), keeping it to 8 bits, which covers shifts (by making the other side 8, clearing it)
+// and rotates (with left + right == 8). SIMD has no 8-bit shifts, so the vector paths shift 16-bit lanes and mask off the bits that crossed
+// over between the two bytes in each lane
+auto shift_bytes(char *first, char *last, unsigned left, unsigned right) noexcept -> void
 {
-  static constexpr std::size_t max_key_val = 256;
+#if defined(HMR_SIMD_AVX2) || defined(HMR_SIMD_SSE2)
+  auto const left_count = _mm_cvtsi32_si128(static_cast<int>(left));
+  auto const right_count = _mm_cvtsi32_si128(static_cast<int>(right));
+  auto const left_mask = static_cast<char>((0xFFU << left) & 0xFFU);
+  auto const right_mask = static_cast<char>(0xFFU >> right);
+#endif
+
+#if defined(HMR_SIMD_AVX2)
+  auto const left_mask_256 = _mm256_set1_epi8(left_mask);
+  auto const right_mask_256 = _mm256_set1_epi8(right_mask);
+
+  for (; last - first >= 32; first += 32)
+  {
+    auto const block = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(first));
+    auto const shifted_left = _mm256_and_si256(_mm256_sll_epi16(block, left_count), left_mask_256);
+    auto const shifted_right = _mm256_and_si256(_mm256_srl_epi16(block, right_count), right_mask_256);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(first), _mm256_or_si256(shifted_left, shifted_right));
+  }
+#endif
+
+#if defined(HMR_SIMD_SSE2)
+  auto const left_mask_128 = _mm_set1_epi8(left_mask);
+  auto const right_mask_128 = _mm_set1_epi8(right_mask);
+
+  for (; last - first >= 16; first += 16)
+  {
+    auto const block = _mm_loadu_si128(reinterpret_cast<__m128i const *>(first));
+    auto const shifted_left = _mm_and_si128(_mm_sll_epi16(block, left_count), left_mask_128);
+    auto const shifted_right = _mm_and_si128(_mm_srl_epi16(block, right_count), right_mask_128);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(first), _mm_or_si128(shifted_left, shifted_right));
+  }
+#endif
+
+  for (; first != last; ++first)
+  {
+    auto const byte = static_cast<unsigned>(static_cast<uint8_t>(*first));
+    *first = static_cast<char>(((byte << left) | (byte >> right)) & 0xFFU);
+  }
+}
 
-  auto output = std::string{};
-  output.reserve(input.size());
 
-  for (auto const &ch : input)
+////////////////////////////////////////////////////////////
+// Writes each byte of [first, last) XORed with the byte before it to out
+auto xor_adjacent(char const *first, char const *last, char *out) noexcept -> void
+{
+#if defined(HMR_SIMD_AVX2)
+  for (; last - first >= 32; first += 32, out += 32)
   {
-    uint8_t a = static_cast<uint8_t>(ch) ^ key;
+    auto const current = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(first));
+    auto const previous = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(first - 1));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), _mm256_xor_si256(current, previous));
+  }
+#endif
 
-    output.push_back(a);
+#if defined(HMR_SIMD_SSE2)
+  for (; last - first >= 16; first += 16, out += 16)
+  {
+    auto const current = _mm_loadu_si128(reinterpret_cast<__m128i const *>(first));
+    auto const previous = _mm_loadu_si128(reinterpret_cast<__m128i const *>(first - 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out), _mm_xor_si128(current, previous));
+  }
+#endif
 
-    key = (key + increment) % max_key_val;
+  for (; first != last; ++first, ++out)
+  {
+    *out = static_cast<char>(*first ^ *(first - 1));
   }
+}
 
-  return output;
+
+#if defined(HMR_SIMD_SSE2)
+////////////////////////////////////////////////////////////
+// Each byte becomes the XOR of itself and every byte before it in the block, doubling the distance covered with each shift
+inline auto prefix_xor_block(__m128i block) noexcept -> __m128i
+{
+  block = _mm_xor_si128(block, _mm_slli_si128(block, 1));
+  block = _mm_xor_si128(block, _mm_slli_si128(block, 2));
+  block = _mm_xor_si128(block, _mm_slli_si128(block, 4));
+  return _mm_xor_si128(block, _mm_slli_si128(block, 8));
 }
+#endif
 
 
 ////////////////////////////////////////////////////////////
-auto shift_left(std::string_view input, std::size_t amount) noexcept -> std::string
+// Writes the running XOR of [first, last) to out, starting from carry, and returns the final value. Each vector is scanned in-register, then
+// XORed with the carry from the vector before, which is the only part that has to wait on the previous vector
+auto prefix_xor_bytes(char const *first, char const *last, char *out, uint8_t carry) noexcept -> uint8_t
 {
-  auto output = std::string{};
-  output.reserve(input.size());
+#if defined(HMR_SIMD_AVX2)
+  auto carry_256 = _mm256_set1_epi8(static_cast<char>(carry));
+  auto const last_byte = _mm256_set1_epi8(15);
 
-  if (amount > bits_per_byte)
+  for (; last - first >= 32; first += 32, out += 32)
   {
-    amount %= bits_per_byte;
+    auto block = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(first));
+
+    // Byte shifts don't cross between the two 128-bit lanes, so scan each lane separately, then XOR the end of the low lane into the high one
+    block = _mm256_xor_si256(block, _mm256_slli_si256(block, 1));
+    block = _mm256_xor_si256(block, _mm256_slli_si256(block, 2));
+    block = _mm256_xor_si256(block, _mm256_slli_si256(block, 4));
+    block = _mm256_xor_si256(block, _mm256_slli_si256(block, 8));
+
+    auto const lane_ends = _mm256_shuffle_epi8(block, last_byte);
+    block = _mm256_xor_si256(block, _mm256_permute2x128_si256(lane_ends, lane_ends, 0x08));
+    block = _mm256_xor_si256(block, carry_256);
+
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), block);
+
+    auto const ends = _mm256_shuffle_epi8(block, last_byte);
+    carry_256 = _mm256_permute2x128_si256(ends, ends, 0x11);
+  }
+
+  carry = static_cast<uint8_t>(_mm_cvtsi128_si32(_mm256_castsi256_si128(carry_256)));
+#endif
+
+#if defined(HMR_SIMD_SSE2)
+  auto carry_128 = _mm_set1_epi8(static_cast<char>(carry));
+
+  for (; last - first >= 16; first += 16, out += 16)
+  {
+    auto const block = _mm_xor_si128(prefix_xor_block(_mm_loadu_si128(reinterpret_cast<__m128i const *>(first))), carry_128);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out), block);
+
+    // Broadcast the last byte, which needs no more than SSE2 by doubling it up until it fills the register
+    auto const high = _mm_unpackhi_epi8(block, block);
+    carry_128 = _mm_shuffle_epi32(_mm_unpackhi_epi16(high, high), 0xFF);
   }
 
-  std::transform(std::begin(input), std::end(input), std::back_inserter(output), [&amount](char const &ch)
-    { return (static_cast<uint8_t>(ch) << amount); });
+  carry = static_cast<uint8_t>(_mm_cvtsi128_si32(carry_128));
+#endif
+
+  for (; first != last; ++first, ++out)
+  {
+    carry ^= static_cast<uint8_t>(*first);
+    *out = static_cast<char>(carry);
+  }
+
+  return carry;
+}
+
+} // namespace
+
+
+////////////////////////////////////////////////////////////
+auto xor_with_key(std::string_view input, std::string_view key) noexcept -> std::string
+{
+  // XORing with an empty key leaves everything as it is
+  if (key.empty())
+  {
+    return std::string{input};
+  }
+
+  auto output = std::string(input.size(), '\0');
+  xor_repeating(input.data(), input.data() + input.size(), key, output.data());
 
   return output;
 }
 
 
 ////////////////////////////////////////////////////////////
-auto shift_right(std::string_view input, std::size_t amount) noexcept -> std::string
+auto xor_with_key(std::string_view input, uint8_t key) noexcept -> std::string
 {
-  auto output = std::string{};
-  output.reserve(input.size());
+  auto const key_char = static_cast<char>(key);
+  return xor_with_key(input, std::string_view{&key_char, 1});
+}
 
-  if (amount > bits_per_byte)
+
+////////////////////////////////////////////////////////////
+auto xor_with_key_inplace(char *data, std::size_t len, std::string_view key) noexcept -> void
+{
+  if (!key.empty())
   {
-    amount %= bits_per_byte;
+    xor_repeating(data, data + len, key, data);
   }
+}
 
-  std::transform(std::begin(input), std::end(input), std::back_inserter(output), [&amount](char const &ch)
-    { return (static_cast<uint8_t>(ch) >> amount); });
 
-  return output;
+////////////////////////////////////////////////////////////
+auto xor_with_key_inplace(char *data, std::size_t len, uint8_t key) noexcept -> void
+{
+  auto const key_char = static_cast<char>(key);
+  xor_with_key_inplace(data, len, std::string_view{&key_char, 1});
 }
 
 
 ////////////////////////////////////////////////////////////
-auto rotate_left(std::string_view input, std::size_t amount, carry_through carry) noexcept -> std::string
+auto xor_rolling(std::string_view input, xor_differential differential, std::size_t thread_count) noexcept -> std::string
 {
+  // Below this, the cost of starting another thread outweighs the time it saves
+  static constexpr std::size_t min_bytes_per_thread = 1 << 20;
+
   auto const len = input.size();
 
-  auto output = std::string{};
+  if (len == 0)
+  {
+    return std::string{};
+  }
 
-  if (carry == carry_through::disabled)
+  auto output = std::string(len, '\0');
+
+  // In input differential mode, each byte is XORed with the original pre-XOR value of the previous byte, so every output byte is independent
+  if (differential == xor_differential::input)
   {
-    if (amount > bits_per_byte)
+    output[0] = input[0];
+    xor_adjacent(input.data() + 1, input.data() + len, output.data() + 1);
+
+    return output;
+  }
+
+  // In output differential mode, each byte is XORed with the resulting post-XOR value of the previous byte, making every output byte the XOR of
+  // all the input bytes up to and including it
+  if (thread_count == 0)
+  {
+    thread_count = std::min(parallel::default_thread_count(), std::max<std::size_t>(1, len / min_bytes_per_thread));
+  }
+
+  thread_count = std::min(thread_count, len);
+
+  if (thread_count > 1)
+  {
+    try
     {
-      amount %= bits_per_byte;
-    }
+      auto const chunk_size = (len + thread_count - 1) / thread_count;
+      auto carries = std::vector<uint8_t>(thread_count, 0);
 
-    output.reserve(len);
+      // First each thread scans its own chunk as if nothing came before it...
+      parallel::run(thread_count, [&](std::size_t index)
+        {
+          auto const begin = std::min(len, index * chunk_size);
+          auto const end = std::min(len, (index + 1) * chunk_size);
 
-    std::transform(std::begin(input), std::end(input), std::back_inserter(output), [&amount](uint8_t const ch)
+          carries[index] = prefix_xor_bytes(input.data() + begin, input.data() + end, output.data() + begin, 0);
+        });
+
+      // ...then each chunk's carry becomes the XOR of every chunk before it, which is XORed across the whole chunk to finish it off
+      auto carry = uint8_t{0};
+
+      for (auto &chunk_carry : carries)
       {
-        auto tmp = ch;
+        carry ^= std::exchange(chunk_carry, carry);
+      }
 
-        for (std::size_t n = 0; n < amount; ++n)
+      parallel::run(thread_count, [&](std::size_t index)
         {
-          // Is there a bit that needs wrapping around?
-          uint8_t carry_bit = (tmp >> 7U) & 1U;
-          tmp = (tmp << 1U) | carry_bit;
-        }
+          auto const begin = std::min(len, index * chunk_size);
+          auto const end = std::min(len, (index + 1) * chunk_size);
+          auto const key = static_cast<char>(carries[index]);
+
+          if (key != 0)
+          {
+            xor_repeating(output.data() + begin, output.data() + end, std::string_view{&key, 1}, output.data() + begin);
+          }
+        });
+
+      return output;
+    } catch (...)
+    {
+      // If the threads couldn't be started, fall back to doing it all on this one
+    }
+  }
+
+  prefix_xor_bytes(input.data(), input.data() + len, output.data(), 0);
+
+  return output;
+}
+
+
+////////////////////////////////////////////////////////////
+auto xor_counter(std::string_view input, uint8_t key, int increment, std::size_t offset) noexcept -> std::string
+{
+  auto output = std::string{input};
+  xor_counter_inplace(output.data(), output.size(), key, increment, offset);
+
+  return output;
+}
+
 
-        return tmp;
-      });
+////////////////////////////////////////////////////////////
+auto xor_counter_inplace(char *data, std::size_t len, uint8_t key, int increment, std::size_t offset) noexcept -> void
+{
+  // The key stream is an arithmetic progression mod 256, so byte n of it is just key + (n * increment), and the increment only matters mod 256
+  auto const step = static_cast<uint8_t>(increment);
+  key = static_cast<uint8_t>(key + ((offset & 0xFF) * step));
+
+  auto *const last = data + len;
 
-  } else if (carry == carry_through::enabled)
+#if defined(HMR_SIMD_AVX2) || defined(HMR_SIMD_SSE2)
+  // A vector's worth of the key stream, which then moves on a whole vector at a time with a single add
+  auto stream = std::array<char, 32>{};
+
+  for (std::size_t i = 0; i < stream.size(); ++i)
   {
-    output = input;
+    stream[i] = static_cast<char>(key + (i * step));
+  }
+#endif
 
-    if (amount > (len * bits_per_byte))
-    {
-      amount %= (len * bits_per_byte);
-    }
+#if defined(HMR_SIMD_AVX2)
+  auto stream_256 = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(stream.data()));
+  auto const step_256 = _mm256_set1_epi8(static_cast<char>(step * 32));
 
-    // Loop through the input the amount of times we want to perform the rotation
-    for (std::size_t n = 0; n < amount; ++n)
-    {
-      uint8_t previous_carry_bit = 0;
+  for (; last - data >= 32; data += 32)
+  {
+    auto const block = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(data));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(data), _mm256_xor_si256(block, stream_256));
 
-      for (auto iter = std::rbegin(output); iter < std::rend(output); ++iter)
-      {
-        auto tmp = static_cast<uint8_t>(*iter);
+    stream_256 = _mm256_add_epi8(stream_256, step_256);
+  }
 
-        // Check if there is a bit on the end of this byte that will need carrying forwards to the next byte
-        uint8_t next_carry_bit = (tmp >> 7U) & 1U;
+  key = static_cast<uint8_t>(_mm_cvtsi128_si32(_mm256_castsi256_si128(stream_256)));
+#endif
 
-        // Now shift the current byte 1 space to the right, and add on any bit that was carried forward from the previous char
-        tmp = (tmp << 1U) | previous_carry_bit;
+#if defined(HMR_SIMD_SSE2)
+  auto const start = static_cast<uint8_t>(stream[0]);
+  auto stream_128 = _mm_add_epi8(_mm_loadu_si128(reinterpret_cast<__m128i const *>(stream.data())), _mm_set1_epi8(static_cast<char>(key - start)));
+  auto const step_128 = _mm_set1_epi8(static_cast<char>(step * 16));
 
-        // Update previous_carry_bit ahead of the next run through
-        previous_carry_bit = next_carry_bit;
+  for (; last - data >= 16; data += 16)
+  {
+    auto const block = _mm_loadu_si128(reinterpret_cast<__m128i const *>(data));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(data), _mm_xor_si128(block, stream_128));
 
-        // Finally, update the current output char with the newly calculated value
-        *iter = static_cast<char>(tmp);
-      }
+    stream_128 = _mm_add_epi8(stream_128, step_128);
+  }
 
-      // At the end of each run through the whole data, wrap any final carry bit back around to the start if necessary
-      output[output.size() - 1] = static_cast<char>((static_cast<uint8_t>(output[output.size() - 1]) | previous_carry_bit));
-    }
+  key = static_cast<uint8_t>(_mm_cvtsi128_si32(stream_128));
+#endif
+
+  for (; data != last; ++data)
+  {
+    *data = static_cast<char>(static_cast<uint8_t>(*data) ^ key);
+    key = static_cast<uint8_t>(key + step);
   }
+}
+
+
+////////////////////////////////////////////////////////////
+auto xor_buffers(std::string_view lhs, std::string_view rhs, char *output) -> void
+{
+  if (lhs.size() != rhs.size())
+  {
+    throw hmr::xcpt::bitwise::invalid_input("Buffers to XOR must be the same length!");
+  }
+
+  auto const *first = lhs.data();
+  auto const *last = first + lhs.size();
+  auto const *other = rhs.data();
+
+#if defined(HMR_SIMD_AVX2)
+  for (; last - first >= 32; first += 32, other += 32, output += 32)
+  {
+    auto const a = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(first));
+    auto const b = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(other));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(output), _mm256_xor_si256(a, b));
+  }
+#endif
+
+#if defined(HMR_SIMD_SSE2)
+  for (; last - first >= 16; first += 16, other += 16, output += 16)
+  {
+    auto const a = _mm_loadu_si128(reinterpret_cast<__m128i const *>(first));
+    auto const b = _mm_loadu_si128(reinterpret_cast<__m128i const *>(other));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(output), _mm_xor_si128(a, b));
+  }
+#endif
+
+  for (; first != last; ++first, ++other, ++output)
+  {
+    *output = static_cast<char>(*first ^ *other);
+  }
+}
+
+
+////////////////////////////////////////////////////////////
+auto xor_buffers(std::string_view lhs, std::string_view rhs) -> std::string
+{
+  auto output = std::string(lhs.size(), '\0');
+  xor_buffers(lhs, rhs, output.data());
 
   return output;
 }
 
 
 ////////////////////////////////////////////////////////////
-auto rotate_right(std::string_view input, std::size_t amount, carry_through carry) noexcept -> std::string
+auto shift_left(std::string_view input, std::size_t amount) noexcept -> std::string
 {
-  auto const len = input.size();
+  auto output = std::string{input};
+  shift_left_inplace(output.data(), output.size(), amount);
 
-  auto output = std::string{};
+  return output;
+}
 
-  if (carry == carry_through::disabled)
+
+////////////////////////////////////////////////////////////
+auto shift_left_inplace(char *data, std::size_t len, std::size_t amount) noexcept -> void
+{
+  if (amount > bits_per_byte)
   {
-    if (amount > bits_per_byte)
-    {
-      amount %= bits_per_byte;
-    }
+    amount %= bits_per_byte;
+  }
 
-    output.reserve(len);
+  // Shifting right by a whole byte clears those bits altogether, leaving only the left shift
+  shift_bytes(data, data + len, static_cast<unsigned>(amount), bits_per_byte);
+}
 
-    std::transform(std::begin(input), std::end(input), std::back_inserter(output), [&amount](uint8_t const ch)
-      {
-        auto tmp = ch;
 
-        for (std::size_t n = 0; n < amount; ++n)
-        {
-          // Is there a bit that needs wrapping around?
-          uint8_t carry_bit = (tmp & 1U) << 7U;
-          tmp = (tmp >> 1U) | carry_bit;
-        }
+////////////////////////////////////////////////////////////
+auto shift_right(std::string_view input, std::size_t amount) noexcept -> std::string
+{
+  auto output = std::string{input};
+  shift_right_inplace(output.data(), output.size(), amount);
+
+  return output;
+}
 
-        return tmp;
-      });
 
-  } else if (carry == carry_through::enabled)
+////////////////////////////////////////////////////////////
+auto shift_right_inplace(char *data, std::size_t len, std::size_t amount) noexcept -> void
+{
+  if (amount > bits_per_byte)
   {
-    output = input;
+    amount %= bits_per_byte;
+  }
 
-    if (amount > (len * bits_per_byte))
-    {
-      amount %= (len * bits_per_byte);
-    }
+  shift_bytes(data, data + len, bits_per_byte, static_cast<unsigned>(amount));
+}
 
-    // Loop through the input the amount of times we want to perform the rotation
-    for (std::size_t n = 0; n < amount; ++n)
-    {
-      uint8_t previous_carry_bit = 0;
 
-      for (auto &ch : output)
-      {
-        auto tmp = static_cast<uint8_t>(ch);
+////////////////////////////////////////////////////////////
+auto rotate_left(std::string_view input, std::size_t amount, carry_through carry) noexcept -> std::string
+{
+  auto output = std::string{input};
+  rotate_left_inplace(output.data(), output.size(), amount, carry);
 
-        // Check if there is a bit on the end of this byte that will need carrying forwards to the next byte
-        uint8_t next_carry_bit = (tmp & 1U) << 7U;
+  return output;
+}
 
-        // Now shift the current byte 1 space to the right, and add on any bit that was carried forward from the previous char
-        tmp = (tmp >> 1U) | previous_carry_bit;
 
-        // Update previous_carry_bit ahead of the next run through
-        previous_carry_bit = next_carry_bit;
+////////////////////////////////////////////////////////////
+auto rotate_left_inplace(char *data, std::size_t len, std::size_t amount, carry_through carry) noexcept -> void
+{
+  if (len == 0)
+  {
+    return;
+  }
 
-        // Finally, update the current output char with the newly calculated value
-        ch = static_cast<char>(tmp);
-      }
+  if (carry == carry_through::disabled)
+  {
+    auto const bits = static_cast<unsigned>(amount % bits_per_byte);
+    shift_bytes(data, data + len, bits, bits_per_byte - bits);
 
-      // At the end of each run through the whole data, wrap any final carry bit back around to the start if necessary
-      output[0] = static_cast<char>((static_cast<uint8_t>(output[0]) | previous_carry_bit));
-    }
+    return;
+  }
+
+  // With carry through, the whole input acts as one big-endian number that rotates as a unit. Rotating by whole bytes just moves them, which
+  // leaves less than a byte's worth to rotate, where each byte takes its low bits from the top of the byte after it (the last from the first)
+  amount %= (len * bits_per_byte);
+  std::rotate(data, data + (amount / bits_per_byte), data + len);
+
+  auto const bits = static_cast<unsigned>(amount % bits_per_byte);
+
+  if (bits == 0)
+  {
+    return;
   }
 
+  auto const first = static_cast<uint8_t>(data[0]);
+
+  for (std::size_t i = 0; i < len; ++i)
+  {
+    auto const next = (i + 1 < len) ? static_cast<uint8_t>(data[i + 1]) : first;
+    data[i] = static_cast<char>((static_cast<uint8_t>(data[i]) << bits) | (next >> (bits_per_byte - bits)));
+  }
+}
+
+
+////////////////////////////////////////////////////////////
+auto rotate_right(std::string_view input, std::size_t amount, carry_through carry) noexcept -> std::string
+{
+  auto output = std::string{input};
+  rotate_right_inplace(output.data(), output.size(), amount, carry);
+
   return output;
 }
 
+
+////////////////////////////////////////////////////////////
+auto rotate_right_inplace(char *data, std::size_t len, std::size_t amount, carry_through carry) noexcept -> void
+{
+  if (len == 0)
+  {
+    return;
+  }
+
+  if (carry == carry_through::disabled)
+  {
+    auto const bits = static_cast<unsigned>(amount % bits_per_byte);
+    shift_bytes(data, data + len, bits_per_byte - bits, bits);
+
+    return;
+  }
+
+  // As rotate_left_inplace(), but each byte takes its high bits from the bottom of the byte before it (the first from the last)
+  amount %= (len * bits_per_byte);
+  std::rotate(data, data + len - (amount / bits_per_byte), data + len);
+
+  auto const bits = static_cast<unsigned>(amount % bits_per_byte);
+
+  if (bits == 0)
+  {
+    return;
+  }
+
+  auto previous = static_cast<uint8_t>(data[len - 1]);
+
+  for (std::size_t i = 0; i < len; ++i)
+  {
+    auto const current = static_cast<uint8_t>(data[i]);
+    data[i] = static_cast<char>((current >> bits) | (previous << (bits_per_byte - bits)));
+    previous = current;
+  }
+}
+
 } // namespace hmr::bitwise
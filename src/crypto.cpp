@@ -1,6 +1,7 @@
 #include "hamarr/crypto.hpp"
 
 #include <algorithm>
+#include <array>
 
 #include <openssl/aes.h>
 #include <openssl/evp.h>
@@ -199,12 +200,14 @@ auto aes_cbc_encrypt(std::string_view input, std::string_view key, std::string c
   // In CBC mode, each block of ciphertext is XORed against the next block of plaintext before that plaintext is encrypted. The IV is used as a fake block of ciphertext to kick things off
   auto previous_ciphertext = iv;
 
-  // Encrypt all the complete blocks first
+  // Encrypt all the complete blocks first, XORing each one into the same buffer rather than allocating a new one every time
+  auto xord = std::string(aes_block_size, '\0');
+
   std::size_t offset = 0;
   for (offset = 0; offset < (num_blocks * aes_block_size); offset += aes_block_size)
   {
     // XOR the plaintext against the previous ciphertext
-    auto xord = hmr::bitwise::xor_with_key(input.substr(offset, aes_block_size), previous_ciphertext);
+    hmr::bitwise::xor_buffers(input.substr(offset, aes_block_size), previous_ciphertext, xord.data());
     auto encrypted_block = aes_ecb_encrypt_block(xord, key);
 
     previous_ciphertext = encrypted_block;
@@ -216,8 +219,8 @@ auto aes_cbc_encrypt(std::string_view input, std::string_view key, std::string c
   if (len % aes_block_size != 0)
   {
     auto final_block = hmr::pkcs7::pad(std::string(input.data() + offset, len - offset));
-    auto xord = hmr::bitwise::xor_with_key(final_block, previous_ciphertext);
-    auto encrypted_block = aes_ecb_encrypt_block(xord, key);
+    hmr::bitwise::xor_buffers(final_block, previous_ciphertext, final_block.data());
+    auto encrypted_block = aes_ecb_encrypt_block(final_block, key);
 
     result += encrypted_block;
   }
@@ -256,18 +259,19 @@ auto aes_cbc_decrypt(std::string_view input, std::string_view key, std::string c
   std::size_t current_block = 1;
 
   // In CBC mode, each block of ciphertext is XORed against the next block of plaintext after that plaintext is decrypted. The IV is used as a fake block of ciphertext to kick things off
-  auto previous_ciphertext = iv;
+  auto previous_ciphertext = std::string_view{iv};
 
   // Decrypt all the blocks
   for (std::size_t offset = 0; offset < len; offset += aes_block_size, ++current_block)
   {
     // Decrypt the block
-    auto decrypted_block = aes_ecb_decrypt_block(input.substr(offset, aes_block_size), key);
+    auto xord = aes_ecb_decrypt_block(input.substr(offset, aes_block_size), key);
 
-    // XOR the plaintext against the previous ciphertext
-    auto xord = hmr::bitwise::xor_with_key(decrypted_block, previous_ciphertext);
+    // XOR the plaintext against the previous ciphertext, in place
+    hmr::bitwise::xor_buffers(xord, previous_ciphertext, xord.data());
 
-    previous_ciphertext = std::string(input.data() + offset, aes_block_size);
+    // The previous ciphertext is still there in the input, so there's no need to copy it
+    previous_ciphertext = input.substr(offset, aes_block_size);
 
     // If this was the last block, check whether we need to remove padding
     if (current_block == num_blocks)
@@ -1,255 +1,1940 @@
 #include "hamarr/format.hpp"
 
 #include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <locale>
+#include <sstream>
 
 #include "hamarr/hex.hpp"
 #include "hamarr/exceptions.hpp"
 
+#include "simd.hpp"
+#include "parallel.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HMR_HAS_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace hmr::fmt
 {
 
+namespace
+{
+
+#if defined(HMR_SIMD_SSE2)
 ////////////////////////////////////////////////////////////
-auto to_upper(std::string_view input) -> std::string
+// Flips the case of every byte in the block that falls within the 26 letters starting at the char used to make the offset, using a single
+// signed comparison - adding the offset moves those letters down to the very bottom of the signed range, i.e. below the limit
+inline auto flip_case(__m128i block, __m128i offset, __m128i limit) noexcept -> __m128i
 {
-  auto output = std::string{};
-  output.reserve(input.size());
+  auto const is_letter = _mm_cmplt_epi8(_mm_add_epi8(block, offset), limit);
+  return _mm_xor_si128(block, _mm_and_si128(is_letter, _mm_set1_epi8(0x20)));
+}
+#endif
 
-  std::transform(input.begin(), input.end(), std::back_inserter(output), [](unsigned char const ch)
-    { return std::toupper(ch); });
-  return output;
+#if defined(HMR_SIMD_AVX2)
+////////////////////////////////////////////////////////////
+inline auto flip_case(__m256i block, __m256i offset, __m256i limit) noexcept -> __m256i
+{
+  auto const is_letter = _mm256_cmpgt_epi8(limit, _mm256_add_epi8(block, offset));
+  return _mm256_xor_si256(block, _mm256_and_si256(is_letter, _mm256_set1_epi8(0x20)));
 }
+#endif
 
 
 ////////////////////////////////////////////////////////////
-auto to_lower(std::string_view input) -> std::string
+// Copies [first, last) to out, flipping the case of any ASCII letters from first_letter ('a' or 'A') to the opposite case. This doesn't depend
+// on the current locale, and works in place if out == first
+void flip_case(char const *first, char const *last, char *out, char first_letter) noexcept
 {
-  auto output = std::string{};
-  output.reserve(input.size());
+#if defined(HMR_SIMD_AVX2)
+  auto const offset_256 = _mm256_set1_epi8(static_cast<char>(0x80 - first_letter));
+  auto const limit_256 = _mm256_set1_epi8(static_cast<char>(0x80 + 26));
 
-  std::transform(input.begin(), input.end(), std::back_inserter(output), [](unsigned char const ch)
-    { return std::tolower(ch); });
-  return output;
+  for (; last - first >= 32; first += 32, out += 32)
+  {
+    auto const block = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(first));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), flip_case(block, offset_256, limit_256));
+  }
+#endif
+
+#if defined(HMR_SIMD_SSE2)
+  auto const offset = _mm_set1_epi8(static_cast<char>(0x80 - first_letter));
+  auto const limit = _mm_set1_epi8(static_cast<char>(0x80 + 26));
+
+  for (; last - first >= 16; first += 16, out += 16)
+  {
+    auto const block = _mm_loadu_si128(reinterpret_cast<__m128i const *>(first));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(out), flip_case(block, offset, limit));
+  }
+#endif
+
+  // Scalar fallback, and the tail end of the SIMD path
+  for (; first != last; ++first, ++out)
+  {
+    auto const is_letter = static_cast<uint8_t>(*first - first_letter) < 26;
+    *out = is_letter ? static_cast<char>(*first ^ 0x20) : *first;
+  }
 }
 
 
 ////////////////////////////////////////////////////////////
-auto escape(std::string_view input) -> std::string
+constexpr auto fold_case(char c) noexcept -> char
 {
-  auto output = std::string{};
-  output.reserve(input.size());
+  return (static_cast<uint8_t>(c - 'A') < 26) ? static_cast<char>(c ^ 0x20) : c;
+}
+
+
+#if defined(HMR_SIMD_SSE2)
+////////////////////////////////////////////////////////////
+inline auto fold_case(__m128i block) noexcept -> __m128i
+{
+  return flip_case(block, _mm_set1_epi8(static_cast<char>(0x80 - 'A')), _mm_set1_epi8(static_cast<char>(0x80 + 26)));
+}
+#endif
+
+
+////////////////////////////////////////////////////////////
+// Compares len bytes of lhs and rhs, ignoring ASCII case
+auto iequals(char const *lhs, char const *rhs, std::size_t len) noexcept -> bool
+{
+  std::size_t i = 0;
 
-  for (auto const &c : input)
+#if defined(HMR_SIMD_SSE2)
+  for (; i + 16 <= len; i += 16)
   {
-    auto const ch = static_cast<uint8_t>(c);
+    auto const a = fold_case(_mm_loadu_si128(reinterpret_cast<__m128i const *>(lhs + i)));
+    auto const b = fold_case(_mm_loadu_si128(reinterpret_cast<__m128i const *>(rhs + i)));
 
-    switch (ch)
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xFFFF)
     {
-      case 0x0A:
-        output += "\\n";
-        break;
-      case 0x0D:
-        output += "\\r";
-        break;
-      case '\\':
-        output += "\\\\";
-        break;
-      default:
-        if (ch <= 0x1F || ch >= 0x7F)
-        {
-          output += ("\\x" + hmr::hex::encode(ch));
-        } else
-        {
-          output += static_cast<char>(ch);
-        }
-        break;
+      return false;
     }
   }
+#endif
 
-  return output;
+  for (; i < len; ++i)
+  {
+    if (fold_case(lhs[i]) != fold_case(rhs[i]))
+    {
+      return false;
+    }
+  }
+
+  return true;
 }
 
 
 ////////////////////////////////////////////////////////////
-auto unescape(std::string_view input) -> std::string
+// Finds the first occurrence of a needle of at least 2 chars, by comparing the first and last char of the needle against a whole vector of
+// candidate positions at once, and then only checking the middle of the needle at positions where both of those matched
+auto find_sequence(char const *first, char const *last, std::string_view needle) noexcept -> char const *
 {
-  auto output = std::string{};
-  output.reserve(input.size());
+  auto const needle_len = needle.size();
+
+#if defined(HMR_SIMD_SSE2)
+  auto const needle_first = _mm_set1_epi8(needle.front());
+  auto const needle_last = _mm_set1_epi8(needle.back());
 
-  for (auto const *pos = std::begin(input); pos != std::end(input); ++pos)
+  // Each block covers 16 candidate starting positions, so we need room for the whole needle after the final one
+  for (; last - first >= static_cast<std::ptrdiff_t>(16 + needle_len - 1); first += 16)
   {
-    // Is it an escape sequence?
-    if (*pos == '\\')
+    auto const block_first = _mm_loadu_si128(reinterpret_cast<__m128i const *>(first));
+    auto const block_last = _mm_loadu_si128(reinterpret_cast<__m128i const *>(first + needle_len - 1));
+    auto const matches = _mm_and_si128(_mm_cmpeq_epi8(block_first, needle_first), _mm_cmpeq_epi8(block_last, needle_last));
+
+    auto mask = static_cast<uint32_t>(_mm_movemask_epi8(matches));
+
+    while (mask != 0)
     {
-      // Is there at least one char remaining?
-      if (pos + 1 >= std::end(input))
+      auto const *candidate = first + simd::trailing_zeros(mask);
+
+      if (std::memcmp(candidate + 1, needle.data() + 1, needle_len - 2) == 0)
       {
-        throw hmr::xcpt::format::need_more_data("Need at least 1 more byte for escape sequence!");
+        return candidate;
       }
 
-      // What kind of escape sequence is it?
-      switch (*++pos)
-      {
-        // Control characters
-        case 'a':
-          output += '\a';
-          break;
-        case 'b':
-          output += '\b';
-          break;
-        case 't':
-          output += '\t';
-          break;
-        case 'n':
-          output += '\n';
-          break;
-        case 'v':
-          output += '\v';
-          break;
-        case 'f':
-          output += '\f';
-          break;
-        case 'r':
-          output += '\r';
-          break;
+      mask &= (mask - 1);
+    }
+  }
+#endif
 
-        // Hex sequences
-        case 'x': {
-          // Are there at least two chars remaining?
-          if (pos + 2 >= std::end(input))
-          {
-            throw hmr::xcpt::format::need_more_data("Ran out of data for hex escape sequence!");
-          }
+  // Scalar fallback, and the tail end of the SIMD path
+  auto const remaining = std::string_view{first, static_cast<std::size_t>(last - first)};
+  auto const pos = remaining.find(needle);
 
-          output += hmr::hex::decode({++pos, 2});
-          ++pos;
-          break;
-        }
+  return (pos == std::string_view::npos) ? last : first + pos;
+}
 
-        // Everything else
-        default:
-          output += *pos;
-          break;
+
+////////////////////////////////////////////////////////////
+// As find_sequence, but ignoring ASCII case by folding both the needle and each block of the input before comparing them
+auto ifind_sequence(char const *first, char const *last, std::string_view needle) noexcept -> char const *
+{
+  auto const needle_len = needle.size();
+
+#if defined(HMR_SIMD_SSE2)
+  auto const needle_first = _mm_set1_epi8(fold_case(needle.front()));
+  auto const needle_last = _mm_set1_epi8(fold_case(needle.back()));
+
+  for (; last - first >= static_cast<std::ptrdiff_t>(16 + needle_len - 1); first += 16)
+  {
+    auto const block_first = fold_case(_mm_loadu_si128(reinterpret_cast<__m128i const *>(first)));
+    auto const block_last = fold_case(_mm_loadu_si128(reinterpret_cast<__m128i const *>(first + needle_len - 1)));
+    auto const matches = _mm_and_si128(_mm_cmpeq_epi8(block_first, needle_first), _mm_cmpeq_epi8(block_last, needle_last));
+
+    auto mask = static_cast<uint32_t>(_mm_movemask_epi8(matches));
+
+    while (mask != 0)
+    {
+      auto const *candidate = first + simd::trailing_zeros(mask);
+
+      if (iequals(candidate, needle.data(), needle_len))
+      {
+        return candidate;
       }
 
+      mask &= (mask - 1);
+    }
+  }
+#endif
 
-    } else
+  // Scalar fallback, and the tail end of the SIMD path
+  for (; last - first >= static_cast<std::ptrdiff_t>(needle_len); ++first)
+  {
+    if (iequals(first, needle.data(), needle_len))
     {
-      output += *pos;
+      return first;
     }
   }
 
-  return output;
+  return last;
 }
 
 
 ////////////////////////////////////////////////////////////
-auto split(std::string_view input, char delimiter, bool collapse_adjacent_delimiters, bool ignore_leading_delimiter) -> std::vector<std::string>
+// How long each byte becomes once escaped in the given mode - 1 means the byte is copied as-is
+constexpr auto escaped_lengths(escape_mode mode) noexcept -> std::array<uint8_t, 256>
 {
-  // Divide the input up into segments by splitting around the delimiter
-  auto segments = std::vector<std::string>{};
+  auto table = std::array<uint8_t, 256>{};
+
+  for (std::size_t i = 0; i < table.size(); ++i)
+  {
+    switch (mode)
+    {
+      case escape_mode::standard:
+        table[i] = (i <= 0x1F || i >= 0x7F) ? 4 : 1; // \xHH
+        break;
+      case escape_mode::json:
+        table[i] = (i <= 0x1F) ? 6 : 1; // \u00HH, with anything from 0x7F upwards passed through as UTF-8
+        break;
+      case escape_mode::c_literal:
+        table[i] = (i <= 0x1F || i >= 0x7F) ? 4 : 1; // \ooo, as a \x escape would swallow any hex digits that follow it
+        break;
+    }
+  }
 
-  auto const *start = std::begin(input);
-  auto const *pos = std::begin(input);
-  auto const *previous_pos = pos;
+  // The short two char escapes
+  table['\n'] = 2;
+  table['\r'] = 2;
+  table['\\'] = 2;
 
-  while (pos != std::end(input))
+  if (mode != escape_mode::standard)
   {
-    pos = std::find(start, std::end(input), delimiter);
+    table['"'] = 2;
+    table['\b'] = 2;
+    table['\t'] = 2;
+    table['\f'] = 2;
+  }
+
+  if (mode == escape_mode::c_literal)
+  {
+    table['\a'] = 2;
+    table['\v'] = 2;
+  }
 
-    // If the very first char was a delimiter, are we ignoring leading delimiters?
-    if (pos == std::begin(input) && ignore_leading_delimiter)
+  return table;
+}
+
+
+// The char that follows the backslash in each of the short two char escapes
+constexpr auto short_escapes = []
+{
+  auto table = std::array<char, 256>{};
+
+  table['\a'] = 'a';
+  table['\b'] = 'b';
+  table['\t'] = 't';
+  table['\n'] = 'n';
+  table['\v'] = 'v';
+  table['\f'] = 'f';
+  table['\r'] = 'r';
+  table['"'] = '"';
+  table['\\'] = '\\';
+
+  return table;
+}();
+
+
+////////////////////////////////////////////////////////////
+struct escape_rules
+{
+  std::array<uint8_t, 256> lengths;
+  byte_class needs_escaping; // Every byte that doesn't escape to itself, so that clean runs of input can be skipped over with SIMD
+};
+
+
+////////////////////////////////////////////////////////////
+constexpr auto make_escape_rules(escape_mode mode) noexcept -> escape_rules
+{
+  auto rules = escape_rules{escaped_lengths(mode), byte_class{}};
+  auto members = std::array<char, 256>{};
+  std::size_t member_count = 0;
+
+  for (std::size_t i = 0; i < rules.lengths.size(); ++i)
+  {
+    if (rules.lengths[i] != 1)
     {
-      // Update the start position and move onto the next iteration of the loop
-      previous_pos = pos;
-      start = pos + 1;
-      continue;
+      members[member_count++] = static_cast<char>(i);
     }
+  }
 
-    // Does this delimiter directly follow the previous delimiter?
-    if (pos == previous_pos + 1)
-    {
-      if (!collapse_adjacent_delimiters)
+  rules.needs_escaping = byte_class{std::string_view{members.data(), member_count}};
+
+  return rules;
+}
+
+
+// Indexed by escape_mode. Built at compile time, so escaping works even from another translation unit's static initialisers
+constexpr auto escape_rules_by_mode = std::array<escape_rules, 3>{make_escape_rules(escape_mode::standard), make_escape_rules(escape_mode::json), make_escape_rules(escape_mode::c_literal)};
+
+
+// The value of each hex digit, or 0xFF for chars that aren't hex digits
+constexpr auto hex_values = []
+{
+  auto table = std::array<uint8_t, 256>{};
+
+  for (auto &value : table)
+  {
+    value = 0xFF;
+  }
+
+  for (uint8_t i = 0; i < 10; ++i)
+  {
+    table['0' + i] = i;
+  }
+
+  for (uint8_t i = 0; i < 6; ++i)
+  {
+    table['A' + i] = 10 + i;
+    table['a' + i] = 10 + i;
+  }
+
+  return table;
+}();
+
+
+// What each char following a backslash unescapes to in standard mode - the control char escapes are mapped, and every other char maps to itself
+constexpr auto unescaped_chars = []
+{
+  auto table = std::array<char, 256>{};
+
+  for (std::size_t i = 0; i < table.size(); ++i)
+  {
+    table[i] = static_cast<char>(i);
+  }
+
+  table['a'] = '\a';
+  table['b'] = '\b';
+  table['t'] = '\t';
+  table['n'] = '\n';
+  table['v'] = '\v';
+  table['f'] = '\f';
+  table['r'] = '\r';
+
+  return table;
+}();
+
+
+////////////////////////////////////////////////////////////
+// Writes the escape sequence for a single byte that needs escaping, returning a pointer one past the last char written
+auto write_escape(char c, escape_mode mode, char *out) noexcept -> char *
+{
+  auto const ch = static_cast<uint8_t>(c);
+
+  *out++ = '\\';
+
+  switch (escape_rules_by_mode[static_cast<std::size_t>(mode)].lengths[ch])
+  {
+    case 2:
+      *out++ = short_escapes[ch];
+      break;
+
+    case 4:
+      if (mode == escape_mode::c_literal)
       {
-        segments.emplace_back(start, pos);
+        *out++ = static_cast<char>('0' + (ch >> 6));
+        *out++ = static_cast<char>('0' + ((ch >> 3) & 7));
+        *out++ = static_cast<char>('0' + (ch & 7));
+      } else
+      {
+        *out++ = 'x';
+        *out++ = hmr::hex::hex_alphabet[ch >> 4];
+        *out++ = hmr::hex::hex_alphabet[ch & 0x0F];
       }
+      break;
 
-    } else
-    {
-      segments.emplace_back(start, pos);
-    }
+    default:
+      *out++ = 'u';
+      *out++ = '0';
+      *out++ = '0';
+      *out++ = hmr::hex::hex_alphabet[ch >> 4];
+      *out++ = hmr::hex::hex_alphabet[ch & 0x0F];
+      break;
+  }
+
+  return out;
+}
+
+
+////////////////////////////////////////////////////////////
+// The exact length of the input once escaped, only visiting the bytes that actually need escaping
+auto escaped_size(std::string_view input, escape_mode mode) noexcept -> std::size_t
+{
+  auto const &rules = escape_rules_by_mode[static_cast<std::size_t>(mode)];
+
+  auto const *last = input.data() + input.size();
+  auto size = input.size();
 
-    previous_pos = pos;
-    start = pos + 1;
+  for (auto const *pos = rules.needs_escaping.find_first(input.data(), last); pos != last; pos = rules.needs_escaping.find_first(pos + 1, last))
+  {
+    size += rules.lengths[static_cast<uint8_t>(*pos)] - 1U;
   }
 
-  return segments;
+  return size;
 }
 
 
-auto split(std::string_view input, std::string_view delimiters, bool collapse_adjacent_delimiters, bool ignore_leading_delimiter) -> std::vector<std::string>
+////////////////////////////////////////////////////////////
+// Escapes the input into out, which must have room for escaped_size() chars
+auto escape_into(std::string_view input, escape_mode mode, char *out) noexcept -> void
 {
-  // Divide the input up into segments by splitting around any of the specified delimiters
-  auto segments = std::vector<std::string>{};
+  auto const &rules = escape_rules_by_mode[static_cast<std::size_t>(mode)];
 
-  auto const *start = std::begin(input);
-  auto const *pos = std::begin(input);
-  auto const *previous_pos = pos;
+  auto const *first = input.data();
+  auto const *last = first + input.size();
 
-  while (pos != std::end(input))
+  // Copy each clean run in one go, then write the escape sequence for the byte that ended it
+  while (first != last)
   {
-    pos = std::find_first_of(start, std::end(input), std::begin(delimiters), std::end(delimiters));
+    auto const *pos = rules.needs_escaping.find_first(first, last);
 
-    // If the very first char was a delimiter, are we ignoring leading delimiters?
-    if (pos == std::begin(input) && ignore_leading_delimiter)
+    std::memcpy(out, first, static_cast<std::size_t>(pos - first));
+    out += (pos - first);
+
+    if (pos == last)
     {
-      // Update the start position and move onto the next iteration of the loop
-      previous_pos = pos;
-      start = pos + 1;
-      continue;
+      break;
     }
 
-    // Does this delimiter follow the previous delimiter?
-    if (pos == previous_pos + 1)
-    {
-      if (!collapse_adjacent_delimiters)
-      {
-        segments.emplace_back(start, pos);
-      }
+    out = write_escape(*pos, mode, out);
+    first = pos + 1;
+  }
+}
 
-    } else
+
+////////////////////////////////////////////////////////////
+// Reads count hex digits starting at pos, where start is only used to report the index of an invalid digit, which throws Error
+template<typename Error = hmr::xcpt::format::invalid_input>
+auto read_hex(char const *pos, std::size_t count, char const *start) -> uint32_t
+{
+  uint32_t value = 0;
+
+  for (std::size_t i = 0; i < count; ++i)
+  {
+    auto const nibble = hex_values[static_cast<uint8_t>(pos[i])];
+
+    if (nibble == 0xFF)
     {
-      segments.emplace_back(start, pos);
+      throw Error("Invalid hex char " + std::string(1, pos[i]) + " at index " + std::to_string(pos + i - start) + "!");
     }
 
-    previous_pos = pos;
-    start = pos + 1;
+    value = (value << 4) | nibble;
   }
 
-  return segments;
+  return value;
 }
 
 
 ////////////////////////////////////////////////////////////
-auto lstrip(std::string_view input, std::string_view any_of_these) -> std::string_view
+// Writes a Unicode code point as UTF-8, returning a pointer one past the last char written. The encoding is never longer than the escape
+// sequence it came from, so this is safe to use when unescaping in place
+auto write_utf8(uint32_t code_point, char *out) noexcept -> char *
 {
-  std::size_t const pos = input.find_first_not_of(any_of_these);
+  if (code_point < 0x80)
+  {
+    *out++ = static_cast<char>(code_point);
+  } else if (code_point < 0x800)
+  {
+    *out++ = static_cast<char>(0xC0 | (code_point >> 6));
+    *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+  } else if (code_point < 0x10000)
+  {
+    *out++ = static_cast<char>(0xE0 | (code_point >> 12));
+    *out++ = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+    *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+  } else
+  {
+    *out++ = static_cast<char>(0xF0 | (code_point >> 18));
+    *out++ = static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+    *out++ = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+    *out++ = static_cast<char>(0x80 | (code_point & 0x3F));
+  }
 
-  return (pos == std::string_view::npos) ? input : input.substr(pos);
+  return out;
 }
 
 
 ////////////////////////////////////////////////////////////
-auto rstrip(std::string_view input, std::string_view any_of_these) -> std::string_view
+[[noreturn]] auto invalid_escape(char const *pos, char const *start) -> void
 {
-  std::size_t const pos = input.find_last_not_of(any_of_these);
+  throw hmr::xcpt::format::invalid_input("Invalid escape sequence \\" + std::string(1, pos[1]) + " at index " + std::to_string(pos - start) + "!");
+}
+
 
-  return (pos == std::string_view::npos) ? input : input.substr(0, pos + 1);
+////////////////////////////////////////////////////////////
+// Each of these unescapes the single escape sequence at first (which points at the backslash, with at least one char following it) into out,
+// returning a pointer one past the end of the escape sequence
+
+////////////////////////////////////////////////////////////
+auto unescape_standard(char const *first, char const *last, char *&out, char const *start) -> char const *
+{
+  if (first[1] != 'x')
+  {
+    *out++ = unescaped_chars[static_cast<uint8_t>(first[1])];
+    return first + 2;
+  }
+
+  // Are there at least two chars remaining for the hex sequence?
+  if (last - first < 4)
+  {
+    throw hmr::xcpt::format::need_more_data("Ran out of data for hex escape sequence!");
+  }
+
+  // Standard mode has always reported bad hex digits the same way as hmr::hex::decode()
+  *out++ = static_cast<char>(read_hex<hmr::xcpt::hex::invalid_input>(first + 2, 2, start));
+  return first + 4;
 }
 
+
 ////////////////////////////////////////////////////////////
-auto strip(std::string_view input, std::string_view any_of_these) -> std::string_view
+auto unescape_json(char const *first, char const *last, char *&out, char const *start) -> char const *
 {
-  return rstrip(lstrip(input, any_of_these), any_of_these);
+  switch (first[1])
+  {
+    case '"':
+    case '\\':
+    case '/':
+      *out++ = first[1];
+      return first + 2;
+
+    case 'b':
+    case 't':
+    case 'n':
+    case 'f':
+    case 'r':
+      *out++ = unescaped_chars[static_cast<uint8_t>(first[1])];
+      return first + 2;
+
+    case 'u':
+      break;
+
+    default:
+      invalid_escape(first, start);
+  }
+
+  if (last - first < 6)
+  {
+    throw hmr::xcpt::format::need_more_data("Ran out of data for \\u escape sequence!");
+  }
+
+  auto code_point = read_hex(first + 2, 4, start);
+  first += 6;
+
+  // Code points outside the Basic Multilingual Plane are escaped as a UTF-16 surrogate pair
+  if (code_point >= 0xD800 && code_point <= 0xDBFF)
+  {
+    if (last - first < 6)
+    {
+      throw hmr::xcpt::format::need_more_data("Ran out of data for the second half of a \\u surrogate pair!");
+    }
+
+    auto const low = (first[0] == '\\' && first[1] == 'u') ? read_hex(first + 2, 4, start) : 0;
+
+    if (low < 0xDC00 || low > 0xDFFF)
+    {
+      throw hmr::xcpt::format::invalid_input("Unpaired high surrogate at index " + std::to_string(first - 6 - start) + "!");
+    }
+
+    code_point = 0x10000 + ((code_point - 0xD800) << 10) + (low - 0xDC00);
+    first += 6;
+  } else if (code_point >= 0xDC00 && code_point <= 0xDFFF)
+  {
+    throw hmr::xcpt::format::invalid_input("Unpaired low surrogate at index " + std::to_string(first - 6 - start) + "!");
+  }
+
+  out = write_utf8(code_point, out);
+  return first;
+}
+
+
+////////////////////////////////////////////////////////////
+auto unescape_c_literal(char const *first, char const *last, char *&out, char const *start) -> char const *
+{
+  auto const *escape = first;
+
+  switch (first[1])
+  {
+    case '\\':
+    case '\'':
+    case '"':
+    case '?':
+      *out++ = first[1];
+      return first + 2;
+
+    case 'a':
+    case 'b':
+    case 't':
+    case 'n':
+    case 'v':
+    case 'f':
+    case 'r':
+      *out++ = unescaped_chars[static_cast<uint8_t>(first[1])];
+      return first + 2;
+
+    // Octal escapes are one to three digits long
+    case '0':
+    case '1':
+    case '2':
+    case '3':
+    case '4':
+    case '5':
+    case '6':
+    case '7': {
+      uint32_t value = 0;
+
+      for (first += 1; first != last && first != escape + 4 && *first >= '0' && *first <= '7'; ++first)
+      {
+        value = (value << 3) | static_cast<uint32_t>(*first - '0');
+      }
+
+      if (value > 0xFF)
+      {
+        throw hmr::xcpt::format::invalid_input("Octal escape sequence out of range at index " + std::to_string(escape - start) + "!");
+      }
+
+      *out++ = static_cast<char>(value);
+      return first;
+    }
+
+    // Hex escapes consume every hex digit that follows them
+    case 'x': {
+      if (last - first < 3)
+      {
+        throw hmr::xcpt::format::need_more_data("Ran out of data for hex escape sequence!");
+      }
+
+      uint32_t value = read_hex(first + 2, 1, start);
+
+      for (first += 3; first != last && hex_values[static_cast<uint8_t>(*first)] != 0xFF; ++first)
+      {
+        value = (value << 4) | hex_values[static_cast<uint8_t>(*first)];
+
+        if (value > 0xFF)
+        {
+          throw hmr::xcpt::format::invalid_input("Hex escape sequence out of range at index " + std::to_string(escape - start) + "!");
+        }
+      }
+
+      *out++ = static_cast<char>(value);
+      return first;
+    }
+
+    // Universal character names
+    case 'u':
+    case 'U': {
+      auto const digits = (first[1] == 'u') ? std::size_t{4} : std::size_t{8};
+
+      if (static_cast<std::size_t>(last - first) < digits + 2)
+      {
+        throw hmr::xcpt::format::need_more_data("Ran out of data for universal character name!");
+      }
+
+      auto const code_point = read_hex(first + 2, digits, start);
+
+      if (code_point > 0x10FFFF || (code_point >= 0xD800 && code_point <= 0xDFFF))
+      {
+        throw hmr::xcpt::format::invalid_input("Invalid universal character name at index " + std::to_string(escape - start) + "!");
+      }
+
+      out = write_utf8(code_point, out);
+      return first + 2 + digits;
+    }
+
+    default:
+      invalid_escape(first, start);
+  }
+}
+
+
+////////////////////////////////////////////////////////////
+// Unescapes [first, last) into out, returning a pointer one past the last char written. The output is never longer than the input, so out may
+// be the same as first to unescape in place
+auto unescape_into(char const *first, char const *last, char *out, escape_mode mode) -> char *
+{
+  auto const *start = first;
+
+  while (first != last)
+  {
+    // Copy the run of chars up to the next escape sequence in one go
+    auto const *backslash = static_cast<char const *>(std::memchr(first, '\\', static_cast<std::size_t>(last - first)));
+    auto const *run_end = (backslash == nullptr) ? last : backslash;
+
+    if (out != first)
+    {
+      std::memmove(out, first, static_cast<std::size_t>(run_end - first));
+    }
+
+    out += (run_end - first);
+    first = run_end;
+
+    if (first == last)
+    {
+      break;
+    }
+
+    // Is there at least one char remaining?
+    if (last - first < 2)
+    {
+      throw hmr::xcpt::format::need_more_data("Need at least 1 more byte for escape sequence!");
+    }
+
+    switch (mode)
+    {
+      case escape_mode::standard:
+        first = unescape_standard(first, last, out, start);
+        break;
+      case escape_mode::json:
+        first = unescape_json(first, last, out, start);
+        break;
+      case escape_mode::c_literal:
+        first = unescape_c_literal(first, last, out, start);
+        break;
+    }
+  }
+
+  return out;
+}
+
+
+////////////////////////////////////////////////////////////
+// One bit per byte of the 64 byte block, set where the byte is c
+inline auto byte_mask(char const *block, char c) noexcept -> uint64_t
+{
+#if defined(HMR_SIMD_AVX2)
+  auto const needle = _mm256_set1_epi8(c);
+  auto const lo = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<__m256i const *>(block)), needle)));
+  auto const hi = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<__m256i const *>(block + 32)), needle)));
+
+  return (uint64_t{hi} << 32) | lo;
+#elif defined(HMR_SIMD_SSE2)
+  auto const needle = _mm_set1_epi8(c);
+  uint64_t mask = 0;
+
+  for (std::size_t i = 0; i < 4; ++i)
+  {
+    auto const chunk = _mm_loadu_si128(reinterpret_cast<__m128i const *>(block + i * 16));
+    mask |= uint64_t{static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)))} << (i * 16);
+  }
+
+  return mask;
+#else
+  uint64_t mask = 0;
+
+  for (std::size_t i = 0; i < 64; ++i)
+  {
+    mask |= uint64_t{block[i] == c} << i;
+  }
+
+  return mask;
+#endif
+}
+
+
+////////////////////////////////////////////////////////////
+// Floating point std::from_chars() and std::to_chars() are newer than the integral ones, so fall back to streams with the classic locale
+template<typename T>
+auto parse_floating(std::string_view input, T &value) noexcept -> bool
+{
+  // Like std::stod(), allow an explicit plus sign, which std::from_chars() doesn't
+  if (input.size() > 1 && input[0] == '+' && input[1] != '-')
+  {
+    input.remove_prefix(1);
+  }
+
+  if (input.empty())
+  {
+    return false;
+  }
+
+  auto parsed = T{};
+  auto const *last = input.data() + input.size();
+
+#if defined(__cpp_lib_to_chars)
+  auto const result = std::from_chars(input.data(), last, parsed);
+
+  if (result.ec != std::errc{} || result.ptr != last)
+  {
+    return false;
+  }
+#else
+  // Streams allocate and can throw, but this path is only taken on older standard libraries
+  try
+  {
+    auto stream = std::istringstream{std::string{input}};
+    stream.imbue(std::locale::classic());
+
+    if (!(stream >> parsed) || stream.peek() != std::char_traits<char>::eof())
+    {
+      return false;
+    }
+  } catch (...)
+  {
+    return false;
+  }
+#endif
+
+  value = parsed;
+  return true;
+}
+
+
+////////////////////////////////////////////////////////////
+template<typename T>
+auto format_floating(char *first, char *last, T value) noexcept -> char *
+{
+#if defined(__cpp_lib_to_chars)
+  auto const result = std::to_chars(first, last, value);
+  return (result.ec == std::errc{}) ? result.ptr : nullptr;
+#else
+  try
+  {
+    auto stream = std::ostringstream{};
+    stream.imbue(std::locale::classic());
+    stream.precision(std::numeric_limits<T>::max_digits10);
+    stream << value;
+
+    auto const formatted = stream.str();
+
+    if (formatted.size() > static_cast<std::size_t>(last - first))
+    {
+      return nullptr;
+    }
+
+    return std::copy(formatted.begin(), formatted.end(), first);
+  } catch (...)
+  {
+    return nullptr;
+  }
+#endif
+}
+
+
+////////////////////////////////////////////////////////////
+// Parses exactly 8 ASCII digits packed into a little-endian word, with the first digit in the lowest byte, using a few multiplications rather
+// than a loop. Returns false if any of them isn't a digit
+inline auto parse_eight_digits(uint64_t chunk, uint64_t &value) noexcept -> bool
+{
+  // Each byte must be 0x30-0x39 - adding 6 to the low nibble only carries into the high nibble for chars above '9'
+  auto const digits_only = ((chunk & 0xF0F0F0F0F0F0F0F0) | (((chunk + 0x0606060606060606) & 0xF0F0F0F0F0F0F0F0) >> 4)) == 0x3333333333333333;
+
+  if (!digits_only)
+  {
+    return false;
+  }
+
+  chunk -= 0x3030303030303030;
+  chunk = (chunk * 10) + (chunk >> 8); // Combine neighbouring digits into 2-digit values in every other byte
+  chunk = (((chunk & 0x000000FF000000FF) * (100 + (1000000ULL << 32))) + (((chunk >> 16) & 0x000000FF000000FF) * (1 + (10000ULL << 32)))) >> 32;
+
+  value = chunk;
+  return true;
+}
+
+} // namespace
+
+
+////////////////////////////////////////////////////////////
+auto to_upper(std::string_view input) -> std::string
+{
+  auto output = std::string(input.size(), '\0');
+  flip_case(input.data(), input.data() + input.size(), output.data(), 'a');
+
+  return output;
+}
+
+
+////////////////////////////////////////////////////////////
+auto to_lower(std::string_view input) -> std::string
+{
+  auto output = std::string(input.size(), '\0');
+  flip_case(input.data(), input.data() + input.size(), output.data(), 'A');
+
+  return output;
+}
+
+
+////////////////////////////////////////////////////////////
+auto to_upper_inplace(char *data, std::size_t len) noexcept -> void
+{
+  flip_case(data, data + len, data, 'a');
+}
+
+
+////////////////////////////////////////////////////////////
+auto to_lower_inplace(char *data, std::size_t len) noexcept -> void
+{
+  flip_case(data, data + len, data, 'A');
+}
+
+
+////////////////////////////////////////////////////////////
+auto iequals(std::string_view lhs, std::string_view rhs) noexcept -> bool
+{
+  return lhs.size() == rhs.size() && iequals(lhs.data(), rhs.data(), lhs.size());
+}
+
+
+////////////////////////////////////////////////////////////
+auto istarts_with(std::string_view input, std::string_view prefix) noexcept -> bool
+{
+  return input.size() >= prefix.size() && iequals(input.data(), prefix.data(), prefix.size());
+}
+
+
+////////////////////////////////////////////////////////////
+auto ifind(std::string_view input, std::string_view needle, std::size_t pos) noexcept -> std::size_t
+{
+  if (pos > input.size())
+  {
+    return std::string_view::npos;
+  }
+
+  // Like std::string_view::find(), an empty needle is found straight away
+  if (needle.empty())
+  {
+    return pos;
+  }
+
+  auto const *last = input.data() + input.size();
+  auto const *found = ifind_sequence(input.data() + pos, last, needle);
+
+  return (found == last) ? std::string_view::npos : static_cast<std::size_t>(found - input.data());
+}
+
+
+////////////////////////////////////////////////////////////
+auto ihash(std::string_view input) noexcept -> std::size_t
+{
+  // Hash the case-folded input 8 bytes at a time, so the hash is the same whichever code path folded it
+  auto mix = [](uint64_t hash, char const *word)
+  {
+    uint64_t value = 0;
+    std::memcpy(&value, word, sizeof(value));
+
+    hash = (hash ^ value) * 0xBF58476D1CE4E5B9;
+    return hash ^ (hash >> 29);
+  };
+
+  auto const len = input.size();
+  auto const *data = input.data();
+
+  uint64_t hash = 0x9E3779B97F4A7C15 ^ len;
+  std::size_t i = 0;
+
+  char folded[16];
+
+#if defined(HMR_SIMD_SSE2)
+  for (; i + 16 <= len; i += 16)
+  {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(folded), fold_case(_mm_loadu_si128(reinterpret_cast<__m128i const *>(data + i))));
+    hash = mix(mix(hash, folded), folded + 8);
+  }
+#endif
+
+  // Fold whatever is left a word at a time, padding the final word with zeros
+  while (i < len)
+  {
+    auto const n = std::min<std::size_t>(8, len - i);
+
+    std::fill(folded, folded + 8, '\0');
+
+    for (std::size_t j = 0; j < n; ++j)
+    {
+      folded[j] = fold_case(data[i + j]);
+    }
+
+    hash = mix(hash, folded);
+    i += n;
+  }
+
+  // Final avalanche, so that every input bit affects every output bit
+  hash ^= hash >> 32;
+  hash *= 0x94D049BB133111EB;
+  hash ^= hash >> 29;
+
+  return hash;
+}
+
+
+////////////////////////////////////////////////////////////
+auto escape(std::string_view input, escape_mode mode) -> std::string
+{
+  auto output = std::string(escaped_size(input, mode), '\0');
+  escape_into(input, mode, output.data());
+
+  return output;
+}
+
+
+////////////////////////////////////////////////////////////
+auto unescape(std::string_view input, escape_mode mode) -> std::string
+{
+  auto output = std::string(input.size(), '\0');
+  auto const *end = unescape_into(input.data(), input.data() + input.size(), output.data(), mode);
+
+  output.resize(static_cast<std::size_t>(end - output.data()));
+
+  return output;
+}
+
+
+////////////////////////////////////////////////////////////
+auto unescape_inplace(char *data, std::size_t len, escape_mode mode) -> std::size_t
+{
+  return static_cast<std::size_t>(unescape_into(data, data + len, data, mode) - data);
+}
+
+
+////////////////////////////////////////////////////////////
+auto byte_class::find_first(char const *first, char const *last) const noexcept -> char const *
+{
+#if defined(HMR_SIMD_SSSE3)
+  if (nibbles_exact_)
+  {
+    // Classify 16 (or 32) bytes at a time by looking up the low and high nibble of each byte with pshufb
+#if defined(HMR_SIMD_AVX2)
+    auto const lo_lut = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<__m128i const *>(lo_nibbles_.data())));
+    auto const hi_lut = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<__m128i const *>(hi_nibbles_.data())));
+    auto const nibble_mask = _mm256_set1_epi8(0x0F);
+
+    for (; last - first >= 32; first += 32)
+    {
+      auto const chunk = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(first));
+      auto const lo = _mm256_shuffle_epi8(lo_lut, _mm256_and_si256(chunk, nibble_mask));
+      auto const hi = _mm256_shuffle_epi8(hi_lut, _mm256_and_si256(_mm256_srli_epi16(chunk, 4), nibble_mask));
+      auto const matches = _mm256_cmpeq_epi8(_mm256_and_si256(lo, hi), _mm256_setzero_si256());
+      auto const mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(matches));
+
+      if (mask != 0)
+      {
+        return first + simd::trailing_zeros(mask);
+      }
+    }
+#endif
+
+    auto const lo_lut_128 = _mm_loadu_si128(reinterpret_cast<__m128i const *>(lo_nibbles_.data()));
+    auto const hi_lut_128 = _mm_loadu_si128(reinterpret_cast<__m128i const *>(hi_nibbles_.data()));
+    auto const nibble_mask_128 = _mm_set1_epi8(0x0F);
+
+    for (; last - first >= 16; first += 16)
+    {
+      auto const chunk = _mm_loadu_si128(reinterpret_cast<__m128i const *>(first));
+      auto const lo = _mm_shuffle_epi8(lo_lut_128, _mm_and_si128(chunk, nibble_mask_128));
+      auto const hi = _mm_shuffle_epi8(hi_lut_128, _mm_and_si128(_mm_srli_epi16(chunk, 4), nibble_mask_128));
+      auto const matches = _mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128());
+      auto const mask = static_cast<uint32_t>(_mm_movemask_epi8(matches)) ^ 0xFFFFU;
+
+      if (mask != 0)
+      {
+        return first + simd::trailing_zeros(mask);
+      }
+    }
+  }
+#endif
+
+  // Scalar fallback, and the tail end of the SIMD path
+  for (; first != last; ++first)
+  {
+    if (contains(*first))
+    {
+      return first;
+    }
+  }
+
+  return last;
+}
+
+
+////////////////////////////////////////////////////////////
+split_view::split_view(std::string_view input, char delimiter, bool collapse_adjacent_delimiters, bool ignore_leading_delimiter) noexcept
+  : input_(input), delimiter_(delimiter), single_delimiter_(true), collapse_adjacent_delimiters_(collapse_adjacent_delimiters), ignore_leading_delimiter_(ignore_leading_delimiter)
+{
+}
+
+
+////////////////////////////////////////////////////////////
+split_view::split_view(std::string_view input, std::string_view delimiters, bool collapse_adjacent_delimiters, bool ignore_leading_delimiter) noexcept
+  : input_(input), delimiters_(delimiters), delimiter_(delimiters.empty() ? '\0' : delimiters.front()), single_delimiter_(delimiters.size() == 1), collapse_adjacent_delimiters_(collapse_adjacent_delimiters), ignore_leading_delimiter_(ignore_leading_delimiter)
+{
+}
+
+
+////////////////////////////////////////////////////////////
+split_view::split_view(std::string_view input, std::string_view delimiters, delimiter_mode mode, bool collapse_adjacent_delimiters, bool ignore_leading_delimiter)
+  : split_view(input, delimiters, collapse_adjacent_delimiters, ignore_leading_delimiter)
+{
+  if (mode == delimiter_mode::whole_string && delimiters.size() > 1)
+  {
+    sequence_ = delimiters;
+    delimiter_length_ = delimiters.size();
+    single_delimiter_ = false;
+  }
+}
+
+
+////////////////////////////////////////////////////////////
+auto split_view::begin() const -> iterator
+{
+  auto it = iterator{};
+  it.parent_ = this;
+  it.next_ = input_.empty() ? nullptr : input_.data();
+
+  advance(it);
+
+  return it;
+}
+
+
+////////////////////////////////////////////////////////////
+auto split_view::find_delimiter(char const *first) const noexcept -> char const *
+{
+  auto const *last = input_.data() + input_.size();
+
+  if (single_delimiter_)
+  {
+    auto const *pos = std::memchr(first, delimiter_, static_cast<std::size_t>(last - first));
+    return (pos == nullptr) ? last : static_cast<char const *>(pos);
+  }
+
+  if (delimiter_length_ > 1)
+  {
+    return find_sequence(first, last, sequence_);
+  }
+
+  return delimiters_.find_first(first, last);
+}
+
+
+////////////////////////////////////////////////////////////
+void split_view::advance(iterator &it) const
+{
+  auto const *last = input_.data() + input_.size();
+
+  while (it.next_ != nullptr)
+  {
+    auto const *start = it.next_;
+    auto const *pos = find_delimiter(start);
+
+    bool const first = it.first_;
+    it.first_ = false;
+
+    // If this segment ends at the end of the input then there's nothing left to scan, otherwise the next segment begins after the delimiter
+    it.next_ = (pos == last) ? nullptr : pos + delimiter_length_;
+
+    // An empty segment before a leading delimiter is only kept if we're not ignoring leading delimiters, and any other empty segment (i.e. between adjacent delimiters, or after a trailing delimiter) is only kept if we're not collapsing them
+    if (start == pos && (first ? ignore_leading_delimiter_ : collapse_adjacent_delimiters_))
+    {
+      continue;
+    }
+
+    it.segment_ = std::string_view{start, static_cast<std::size_t>(pos - start)};
+    it.done_ = false;
+    return;
+  }
+
+  it.segment_ = std::string_view{};
+  it.done_ = true;
+}
+
+
+////////////////////////////////////////////////////////////
+auto split_view::iterator::operator++() -> iterator &
+{
+  parent_->advance(*this);
+  return *this;
+}
+
+
+////////////////////////////////////////////////////////////
+auto split_view::iterator::operator++(int) -> iterator
+{
+  auto tmp = *this;
+  parent_->advance(*this);
+  return tmp;
+}
+
+
+////////////////////////////////////////////////////////////
+auto split(std::string_view input, char delimiter, bool collapse_adjacent_delimiters, bool ignore_leading_delimiter) -> std::vector<std::string>
+{
+  // Divide the input up into segments by splitting around the delimiter
+  auto segments = std::vector<std::string>{};
+
+  for (auto const segment : split_view(input, delimiter, collapse_adjacent_delimiters, ignore_leading_delimiter))
+  {
+    segments.emplace_back(segment);
+  }
+
+  return segments;
+}
+
+
+////////////////////////////////////////////////////////////
+auto split(std::string_view input, std::string_view delimiters, bool collapse_adjacent_delimiters, bool ignore_leading_delimiter) -> std::vector<std::string>
+{
+  // Divide the input up into segments by splitting around any of the specified delimiters
+  auto segments = std::vector<std::string>{};
+
+  for (auto const segment : split_view(input, delimiters, collapse_adjacent_delimiters, ignore_leading_delimiter))
+  {
+    segments.emplace_back(segment);
+  }
+
+  return segments;
+}
+
+
+////////////////////////////////////////////////////////////
+auto split(std::string_view input, std::string_view delimiters, delimiter_mode mode, bool collapse_adjacent_delimiters, bool ignore_leading_delimiter) -> std::vector<std::string>
+{
+  auto segments = std::vector<std::string>{};
+
+  for (auto const segment : split_view(input, delimiters, mode, collapse_adjacent_delimiters, ignore_leading_delimiter))
+  {
+    segments.emplace_back(segment);
+  }
+
+  return segments;
+}
+
+
+////////////////////////////////////////////////////////////
+auto split_into(std::vector<std::string_view> &output, std::string_view input, char delimiter, bool collapse_adjacent_delimiters, bool ignore_leading_delimiter) -> void
+{
+  // Clearing keeps the existing capacity, so a vector reused across calls stops allocating once it's big enough
+  output.clear();
+
+  for (auto const segment : split_view(input, delimiter, collapse_adjacent_delimiters, ignore_leading_delimiter))
+  {
+    output.push_back(segment);
+  }
+}
+
+
+////////////////////////////////////////////////////////////
+auto split_into(std::vector<std::string_view> &output, std::string_view input, std::string_view delimiters, bool collapse_adjacent_delimiters, bool ignore_leading_delimiter) -> void
+{
+  output.clear();
+
+  for (auto const segment : split_view(input, delimiters, collapse_adjacent_delimiters, ignore_leading_delimiter))
+  {
+    output.push_back(segment);
+  }
+}
+
+
+////////////////////////////////////////////////////////////
+auto split_into(std::vector<std::string_view> &output, std::string_view input, std::string_view delimiters, delimiter_mode mode, bool collapse_adjacent_delimiters, bool ignore_leading_delimiter) -> void
+{
+  output.clear();
+
+  for (auto const segment : split_view(input, delimiters, mode, collapse_adjacent_delimiters, ignore_leading_delimiter))
+  {
+    output.push_back(segment);
+  }
+}
+
+
+////////////////////////////////////////////////////////////
+auto split_parallel(std::string_view input, char delimiter, bool collapse_adjacent_delimiters, bool ignore_leading_delimiter, std::size_t thread_count) -> std::vector<std::pair<std::size_t, std::size_t>>
+{
+  using segment = std::pair<std::size_t, std::size_t>;
+
+  // Below this, the cost of starting another thread outweighs the time it saves
+  static constexpr std::size_t min_bytes_per_thread = 1 << 20;
+
+  auto const len = input.size();
+
+  if (len == 0)
+  {
+    return std::vector<segment>{};
+  }
+
+  if (thread_count == 0)
+  {
+    thread_count = std::min(parallel::default_thread_count(), std::max<std::size_t>(1, len / min_bytes_per_thread));
+  }
+
+  thread_count = std::min(thread_count, len);
+
+  // With a single thread there are no chunk boundaries to fix up, so just build the segments directly
+  if (thread_count == 1)
+  {
+    auto segments = std::vector<segment>{};
+
+    for (auto const part : split_view(input, delimiter, collapse_adjacent_delimiters, ignore_leading_delimiter))
+    {
+      auto const begin = static_cast<std::size_t>(part.data() - input.data());
+      segments.emplace_back(begin, begin + part.size());
+    }
+
+    return segments;
+  }
+
+  auto const chunk_size = (len + thread_count - 1) / thread_count;
+
+  // Apply the same rules as split_view - an empty segment is only kept if it's the leading one and we're not ignoring leading delimiters, or it's any other one and we're not collapsing adjacent delimiters
+  auto keep = [&](std::size_t begin, std::size_t end)
+  { return begin != end || (begin == 0 ? !ignore_leading_delimiter : !collapse_adjacent_delimiters); };
+
+  // First, each thread finds all of the delimiters in its own chunk of the input
+  auto delimiters = std::vector<std::vector<std::size_t>>(thread_count);
+
+  parallel::run(thread_count, [&](std::size_t index)
+    {
+      auto const *first = input.data() + std::min(len, index * chunk_size);
+      auto const *last = input.data() + std::min(len, (index + 1) * chunk_size);
+
+      auto &found = delimiters[index];
+
+      while (first != last)
+      {
+        auto const *pos = static_cast<char const *>(std::memchr(first, delimiter, static_cast<std::size_t>(last - first)));
+        if (pos == nullptr)
+        {
+          break;
+        }
+
+        found.push_back(static_cast<std::size_t>(pos - input.data()));
+        first = pos + 1;
+      }
+    });
+
+  // Fix up the chunk boundaries - the first segment in each chunk starts after the last delimiter found in any earlier chunk
+  auto segment_starts = std::vector<std::size_t>(thread_count);
+  std::size_t next_start = 0;
+
+  for (std::size_t i = 0; i < thread_count; ++i)
+  {
+    segment_starts[i] = next_start;
+
+    if (!delimiters[i].empty())
+    {
+      next_start = delimiters[i].back() + 1;
+    }
+  }
+
+  // Now each thread turns its delimiters into the segments that they terminate
+  auto chunk_segments = std::vector<std::vector<segment>>(thread_count);
+
+  parallel::run(thread_count, [&](std::size_t index)
+    {
+      auto &local = chunk_segments[index];
+      local.reserve(delimiters[index].size());
+
+      auto begin = segment_starts[index];
+
+      for (auto const end : delimiters[index])
+      {
+        if (keep(begin, end))
+        {
+          local.emplace_back(begin, end);
+        }
+
+        begin = end + 1;
+      }
+
+      // Free the delimiter positions as soon as we're done with them, as for newline-delimited data there's one per line
+      delimiters[index] = std::vector<std::size_t>{};
+    });
+
+  // Finally, stitch the segments from each chunk together, plus whatever follows the final delimiter
+  auto offsets = std::vector<std::size_t>(thread_count + 1);
+  for (std::size_t i = 0; i < thread_count; ++i)
+  {
+    offsets[i + 1] = offsets[i] + chunk_segments[i].size();
+  }
+
+  auto segments = std::vector<segment>(offsets.back());
+
+  parallel::run(thread_count, [&](std::size_t index)
+    { std::copy(std::begin(chunk_segments[index]), std::end(chunk_segments[index]), std::begin(segments) + static_cast<std::ptrdiff_t>(offsets[index])); });
+
+  if (keep(next_start, len))
+  {
+    segments.emplace_back(next_start, len);
+  }
+
+  return segments;
+}
+
+
+////////////////////////////////////////////////////////////
+auto try_parse(std::string_view input, float &value) noexcept -> bool
+{
+  return parse_floating(input, value);
+}
+
+
+////////////////////////////////////////////////////////////
+auto try_parse(std::string_view input, double &value) noexcept -> bool
+{
+  return parse_floating(input, value);
+}
+
+
+////////////////////////////////////////////////////////////
+auto try_parse(std::string_view input, long double &value) noexcept -> bool
+{
+  return parse_floating(input, value);
+}
+
+
+////////////////////////////////////////////////////////////
+auto parse_digits(std::string_view digits, uint64_t &value) noexcept -> bool
+{
+  // Any more than 19 digits might not fit
+  if (digits.empty() || digits.size() > 19)
+  {
+    return false;
+  }
+
+  uint64_t parsed = 0;
+  std::size_t i = 0;
+
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  for (; i + 8 <= digits.size(); i += 8)
+  {
+    uint64_t chunk = 0;
+    uint64_t eight = 0;
+
+    std::memcpy(&chunk, digits.data() + i, sizeof(chunk));
+
+    if (!parse_eight_digits(chunk, eight))
+    {
+      return false;
+    }
+
+    parsed = (parsed * 100000000) + eight;
+  }
+#endif
+
+  for (; i < digits.size(); ++i)
+  {
+    auto const digit = static_cast<uint8_t>(digits[i] - '0');
+
+    if (digit > 9)
+    {
+      return false;
+    }
+
+    parsed = (parsed * 10) + digit;
+  }
+
+  value = parsed;
+  return true;
+}
+
+
+////////////////////////////////////////////////////////////
+auto format_into(char *first, char *last, float value) noexcept -> char *
+{
+  return format_floating(first, last, value);
+}
+
+
+////////////////////////////////////////////////////////////
+auto format_into(char *first, char *last, double value) noexcept -> char *
+{
+  return format_floating(first, last, value);
+}
+
+
+////////////////////////////////////////////////////////////
+auto format_into(char *first, char *last, long double value) noexcept -> char *
+{
+  return format_floating(first, last, value);
+}
+
+
+////////////////////////////////////////////////////////////
+auto lstrip(std::string_view input, std::string_view any_of_these) -> std::string_view
+{
+  std::size_t const pos = input.find_first_not_of(any_of_these);
+
+  // If every char is to be stripped, strip them all
+  return (pos == std::string_view::npos) ? input.substr(input.size()) : input.substr(pos);
+}
+
+
+////////////////////////////////////////////////////////////
+auto rstrip(std::string_view input, std::string_view any_of_these) -> std::string_view
+{
+  std::size_t const pos = input.find_last_not_of(any_of_these);
+
+  // If every char is to be stripped, strip them all
+  return (pos == std::string_view::npos) ? input.substr(0, 0) : input.substr(0, pos + 1);
+}
+
+////////////////////////////////////////////////////////////
+auto strip(std::string_view input, std::string_view any_of_these) -> std::string_view
+{
+  return rstrip(lstrip(input, any_of_these), any_of_these);
+}
+
+
+
+////////////////////////////////////////////////////////////
+mapped_file::mapped_file(std::string const &path, bool sequential)
+{
+#if defined(HMR_HAS_MMAP)
+  auto const fd = ::open(path.c_str(), O_RDONLY);
+
+  if (fd == -1)
+  {
+    throw hmr::xcpt::format::file_error("Could not open " + path + ": " + std::strerror(errno));
+  }
+
+  struct stat info = {};
+
+  if (::fstat(fd, &info) == -1)
+  {
+    auto const err = errno;
+    ::close(fd);
+    throw hmr::xcpt::format::file_error("Could not get the size of " + path + ": " + std::strerror(err));
+  }
+
+  size_ = static_cast<std::size_t>(info.st_size);
+
+  // Mapping an empty file fails, but there's nothing to map anyway
+  if (size_ == 0)
+  {
+    ::close(fd);
+    return;
+  }
+
+  auto *const address = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  auto const err = errno;
+  ::close(fd); // The mapping keeps its own reference to the file
+
+  if (address == MAP_FAILED)
+  {
+    throw hmr::xcpt::format::file_error("Could not memory map " + path + ": " + std::strerror(err));
+  }
+
+  ::madvise(address, size_, sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+
+  data_ = static_cast<char const *>(address);
+  mapped_ = true;
+#else
+  static_cast<void>(sequential);
+
+  auto file = std::ifstream{path, std::ios::binary | std::ios::ate};
+
+  if (!file)
+  {
+    throw hmr::xcpt::format::file_error("Could not open " + path + "!");
+  }
+
+  size_ = static_cast<std::size_t>(file.tellg());
+  buffer_ = std::make_unique<char[]>(size_);
+
+  file.seekg(0);
+
+  if (!file.read(buffer_.get(), static_cast<std::streamsize>(size_)))
+  {
+    throw hmr::xcpt::format::file_error("Could not read " + path + "!");
+  }
+
+  data_ = buffer_.get();
+#endif
+}
+
+
+////////////////////////////////////////////////////////////
+mapped_file::~mapped_file()
+{
+#if defined(HMR_HAS_MMAP)
+  if (mapped_)
+  {
+    ::munmap(const_cast<char *>(data_), size_);
+  }
+#endif
+}
+
+
+////////////////////////////////////////////////////////////
+mapped_file::mapped_file(mapped_file &&other) noexcept
+  : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)), mapped_(std::exchange(other.mapped_, false)), buffer_(std::move(other.buffer_))
+{
+}
+
+
+////////////////////////////////////////////////////////////
+auto mapped_file::operator=(mapped_file &&other) noexcept -> mapped_file &
+{
+  if (this != &other)
+  {
+    // Let a temporary take care of releasing whatever this currently holds
+    auto old = mapped_file{};
+
+    std::swap(old.data_, data_);
+    std::swap(old.size_, size_);
+    std::swap(old.mapped_, mapped_);
+    std::swap(old.buffer_, buffer_);
+
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+    mapped_ = std::exchange(other.mapped_, false);
+    buffer_ = std::move(other.buffer_);
+  }
+
+  return *this;
+}
+
+
+////////////////////////////////////////////////////////////
+line_reader::line_reader(mapped_file file) noexcept
+  : file_(std::move(file)), input_(file_.view()), pos_(input_.data()), scan_(input_.data())
+{
+}
+
+
+////////////////////////////////////////////////////////////
+line_reader::line_reader(std::string_view input) noexcept
+  : input_(input), pos_(input_.data()), scan_(input_.data())
+{
+}
+
+
+////////////////////////////////////////////////////////////
+auto line_reader::next(std::string_view &line) noexcept -> bool
+{
+  auto const *last = input_.data() + input_.size();
+
+  if (pos_ == last)
+  {
+    return false;
+  }
+
+  // Find the next newline, refilling the mask of newline positions a block at a time until one turns up or we run out of input
+  while (mask_ == 0 && scan_ != last)
+  {
+    block_ = scan_;
+
+    if (last - scan_ >= 64)
+    {
+      mask_ = byte_mask(scan_, '\n');
+      scan_ += 64;
+    } else
+    {
+      for (auto const *pos = scan_; pos != last; ++pos)
+      {
+        mask_ |= uint64_t{*pos == '\n'} << (pos - scan_);
+      }
+
+      scan_ = last;
+    }
+  }
+
+  auto const *newline = last;
+
+  if (mask_ != 0)
+  {
+    newline = block_ + simd::trailing_zeros(mask_);
+    mask_ &= (mask_ - 1);
+  }
+
+  auto const *line_end = newline;
+
+  if (line_end != pos_ && *(line_end - 1) == '\r')
+  {
+    --line_end;
+  }
+
+  line = std::string_view{pos_, static_cast<std::size_t>(line_end - pos_)};
+  pos_ = (newline == last) ? last : newline + 1;
+
+  return true;
+}
+
+
+////////////////////////////////////////////////////////////
+auto line_reader::begin() noexcept -> iterator
+{
+  auto it = iterator{};
+  it.reader_ = this;
+
+  return ++it;
+}
+
+
+////////////////////////////////////////////////////////////
+auto line_reader::iterator::operator++() noexcept -> iterator &
+{
+  if (!reader_->next(line_))
+  {
+    reader_ = nullptr;
+  }
+
+  return *this;
+}
+
+
+////////////////////////////////////////////////////////////
+auto line_reader::iterator::operator++(int) noexcept -> iterator
+{
+  auto tmp = *this;
+  ++(*this);
+
+  return tmp;
+}
+
+
+
+////////////////////////////////////////////////////////////
+csv_parser::csv_parser(char delimiter, char quote) noexcept
+  : delimiter_(delimiter), quote_(quote)
+{
+}
+
+
+////////////////////////////////////////////////////////////
+// Stage one - finds every structural char (delimiters and newlines outside of quotes) 64 bytes at a time, returning whether the input ends
+// inside a quoted field
+auto csv_parser::find_structurals(std::string_view input) -> bool
+{
+  structurals_.clear();
+
+  auto const len = input.size();
+  uint64_t in_quotes_carry = 0; // All ones if the previous block ended inside quotes
+
+  char padded[64];
+
+  for (std::size_t offset = 0; offset < len; offset += 64)
+  {
+    auto const *block = input.data() + offset;
+    auto valid = ~uint64_t{0};
+
+    // Copy the final partial block somewhere it can be safely read 64 bytes at a time, and ignore whatever follows the input
+    if (len - offset < 64)
+    {
+      std::memset(padded, 0, sizeof(padded));
+      std::memcpy(padded, block, len - offset);
+      block = padded;
+      valid = (uint64_t{1} << (len - offset)) - 1;
+    }
+
+    auto const quotes = byte_mask(block, quote_) & valid;
+    auto const in_quotes = simd::prefix_xor(quotes) ^ in_quotes_carry;
+    auto structurals = (byte_mask(block, delimiter_) | byte_mask(block, '\n')) & ~in_quotes & valid;
+
+    in_quotes_carry = static_cast<uint64_t>(-static_cast<int64_t>(in_quotes >> 63));
+
+    while (structurals != 0)
+    {
+      structurals_.push_back(offset + simd::trailing_zeros(structurals));
+      structurals &= (structurals - 1);
+    }
+  }
+
+  return in_quotes_carry != 0;
+}
+
+
+////////////////////////////////////////////////////////////
+auto csv_parser::end_row(bool blank_line) -> void
+{
+  // A blank line has nothing between its newlines, which isn't the same as a row holding one empty field - that can also come from a quoted
+  // empty field, "", which is a real row
+  if (blank_line && fields_.size() - row_starts_.back() == 1)
+  {
+    fields_.pop_back();
+    return;
+  }
+
+  row_starts_.push_back(fields_.size());
+}
+
+
+////////////////////////////////////////////////////////////
+auto csv_parser::parse(std::string_view input, bool last_chunk) -> std::size_t
+{
+  auto const in_quotes = find_structurals(input);
+
+  if (last_chunk && in_quotes)
+  {
+    throw hmr::xcpt::format::need_more_data("Reached the end of the CSV data inside a quoted field!");
+  }
+
+  fields_.clear();
+  row_starts_.assign(1, 0);
+
+  // Stage two - the structural chars split the input into fields and rows. Returns whether the field was empty in the raw input, i.e. before
+  // any quotes were removed
+  auto add_field = [this, input](std::size_t first, std::size_t last, bool row_end)
+  {
+    if (row_end && last > first && input[last - 1] == '\r')
+    {
+      --last;
+    }
+
+    auto const raw_empty = (first == last);
+
+    if (last - first >= 2 && input[first] == quote_ && input[last - 1] == quote_)
+    {
+      ++first;
+      --last;
+    }
+
+    fields_.push_back(input.substr(first, last - first));
+    return raw_empty;
+  };
+
+  std::size_t field_start = 0;
+  std::size_t consumed = 0;
+
+  for (auto const pos : structurals_)
+  {
+    auto const row_end = (input[pos] == '\n');
+
+    auto const raw_empty = add_field(field_start, pos, row_end);
+    field_start = pos + 1;
+
+    if (row_end)
+    {
+      end_row(raw_empty);
+      consumed = field_start;
+    }
+  }
+
+  // The final row doesn't need a newline if there's no more data to come, but otherwise it may not be complete yet
+  if (!last_chunk)
+  {
+    fields_.resize(row_starts_.back());
+    return consumed;
+  }
+
+  if (field_start < input.size() || fields_.size() > row_starts_.back())
+  {
+    end_row(add_field(field_start, input.size(), true));
+  }
+
+  return input.size();
+}
+
+
+////////////////////////////////////////////////////////////
+auto csv_unquote(std::string_view field, char quote) -> std::string
+{
+  auto output = std::string{};
+  output.reserve(field.size());
+
+  for (std::size_t i = 0; i < field.size(); ++i)
+  {
+    output.push_back(field[i]);
+
+    // Skip the second of each pair of quotes
+    if (field[i] == quote && i + 1 < field.size() && field[i + 1] == quote)
+    {
+      ++i;
+    }
+  }
+
+  return output;
+}
+
+
+
+////////////////////////////////////////////////////////////
+auto builder::append(std::size_t count, char c) -> builder &
+{
+  buffer_.append(count, c);
+  return *this;
+}
+
+
+////////////////////////////////////////////////////////////
+auto builder::append_hex(std::string_view input, bool delimited) -> builder &
+{
+  if (input.empty())
+  {
+    return *this;
+  }
+
+  auto const width = delimited ? std::size_t{3} : std::size_t{2};
+  auto *out = grow(input.size() * width - (delimited ? 1 : 0));
+
+  for (std::size_t i = 0; i < input.size(); ++i)
+  {
+    auto const ch = static_cast<uint8_t>(input[i]);
+
+    if (delimited && i != 0)
+    {
+      *out++ = ' ';
+    }
+
+    *out++ = hmr::hex::hex_alphabet[ch >> 4];
+    *out++ = hmr::hex::hex_alphabet[ch & 0x0F];
+  }
+
+  return *this;
+}
+
+
+////////////////////////////////////////////////////////////
+auto builder::append_escaped(std::string_view input, escape_mode mode) -> builder &
+{
+  escape_into(input, mode, grow(escaped_size(input, mode)));
+  return *this;
+}
+
+
+////////////////////////////////////////////////////////////
+auto builder::grow(std::size_t count) -> char *
+{
+  auto const size = buffer_.size();
+  buffer_.resize(size + count);
+
+  return buffer_.data() + size;
 }
 
 } // namespace hmr::fmt
@@ -2,6 +2,8 @@
 
 #include <sstream>
 
+#include "hamarr/format.hpp"
+
 namespace hmr::hex
 {
 
@@ -96,103 +98,59 @@ auto decode(std::string_view input) -> std::string
 ////////////////////////////////////////////////////////////
 auto dump(std::string_view input) -> std::string
 {
-  auto output = std::stringstream{};
-
   constexpr std::size_t bytes_per_line = 16; // TODO: Allow the user to specify this
 
-  std::size_t const len = input.size();
+  // How many bytes is each half of a hexdump line?
+  constexpr std::size_t half_line = bytes_per_line / 2;
 
-  uint32_t line_num = 0;
+  // How many chars wide is the hex part of a line? Each byte is two hex digits and a space, with an extra space between the two halves
+  constexpr std::size_t hex_width = bytes_per_line * 3;
 
-  // How many lines-worth of bytes are there in the input?
-  std::size_t const lines = len / bytes_per_line;
+  std::size_t const len = input.size();
 
-  // How many extra bytes for a partial line?
-  std::size_t const leftovers = len % 16;
+  // Each line is an 8 digit offset, the hex, and the bytes themselves, plus a few separators
+  auto output = hmr::fmt::builder{((len / bytes_per_line) + 2) * (8 + 2 + hex_width + 3 + bytes_per_line + 2)};
 
-  // How many bytes is each half of a hexdump line?
-  std::size_t const half_line = bytes_per_line / 2;
+  uint32_t line_num = 0;
 
-  // Lambda to escape unprintable chars as '.'
-  auto escape = [](std::string_view unescaped) -> std::string
-  {
-    auto escaped = std::string{};
-    std::transform(std::cbegin(unescaped), std::cend(unescaped), std::back_inserter(escaped), [](char const ch)
-      {
-        if (ch <= 0x1F || ch >= 0x7F)
-        {
-          return '.';
-        } else
-        {
-          return ch;
-        }
-      });
-
-    return escaped;
-  };
-
-  // Process all the complete lines
-  for (std::size_t i = 0; i < lines; ++i)
+  for (std::size_t start = 0; start < len; start += bytes_per_line)
   {
-    std::size_t start = i * bytes_per_line;
-
-    auto const lhs = hmr::hex::encode(input.substr(start, half_line));
-    auto const rhs = hmr::hex::encode(input.substr(start + half_line, half_line));
-
     auto const line = input.substr(start, bytes_per_line);
 
-    auto const escaped = escape(line);
-
-    if (i != 0)
+    if (start != 0)
     {
-      output << '\n';
+      output.append('\n');
     }
 
-    output << hmr::hex::encode(line_num, false) << "  " << lhs << "  " << rhs << "  |" << escaped << '|';
-
-    line_num += bytes_per_line;
-  }
-
-  // Add on any bytes for a final partial line
-  if (leftovers > 0 && leftovers <= half_line)
-  {
-    auto const lhs = hmr::hex::encode(input.substr(len - leftovers));
+    output.append_hex(line_num).append("  ");
 
-    auto const escaped = escape(input.substr(len - leftovers));
+    // Hex for each half of the line, padded out to full width for a final partial line
+    auto const hex_start = output.size();
 
-    std::size_t remaining = ((bytes_per_line - leftovers) * 3) + 1;
+    output.append_hex(line.substr(0, half_line), true);
 
-    if (lines > 1)
+    if (line.size() > half_line)
     {
-      output << '\n';
+      output.append("  ").append_hex(line.substr(half_line), true);
     }
 
-    output << hmr::hex::encode(line_num, false) << "  " << lhs << std::string(remaining, ' ') << "  |" << escaped << '|';
+    output.append(hex_width - (output.size() - hex_start), ' ').append("  |");
 
-  } else if (leftovers > half_line)
-  {
-    auto const lhs = hmr::hex::encode(input.substr(len - leftovers, half_line));
-    auto const rhs = hmr::hex::encode(input.substr(len - leftovers + half_line, half_line));
-
-    auto const escaped = escape(input.substr(len - leftovers));
-
-    std::size_t remaining = ((bytes_per_line - leftovers) * 3);
-
-    if (lines > 1)
+    // Escape unprintable chars as '.'
+    for (auto const ch : line)
     {
-      output << '\n';
+      output.append((ch <= 0x1F || ch >= 0x7F) ? '.' : ch);
     }
 
-    output << hmr::hex::encode(line_num, false) << "  " << lhs << "  " << rhs << std::string(remaining, ' ') << "  |" << escaped << '|';
+    output.append('|');
+
+    line_num += static_cast<uint32_t>(line.size());
   }
 
   // Add a final line just with the total size in bytes
-  line_num += leftovers;
-  output << '\n'
-         << hmr::hex::encode(line_num, false);
-
+  output.append('\n').append_hex(line_num);
 
-  return output.str();
+  return std::move(output).str();
 }
 
 
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace hmr::parallel
+{
+
+////////////////////////////////////////////////////////////
+// How many threads to use when the caller hasn't said - never less than 1
+inline auto default_thread_count() noexcept -> std::size_t
+{
+  auto const n = std::thread::hardware_concurrency();
+  return (n == 0) ? 1 : static_cast<std::size_t>(n);
+}
+
+
+////////////////////////////////////////////////////////////
+// Calls task(index) for every index in [0, thread_count), each on its own thread (the calling thread takes index 0). Any exception thrown by a
+// task is rethrown on the calling thread once all of the tasks have finished
+template<typename Task>
+void run(std::size_t thread_count, Task const &task)
+{
+  auto errors = std::vector<std::exception_ptr>(thread_count);
+
+  auto guarded = [&task, &errors](std::size_t index)
+  {
+    try
+    {
+      task(index);
+    } catch (...)
+    {
+      errors[index] = std::current_exception();
+    }
+  };
+
+  auto threads = std::vector<std::thread>{};
+  threads.reserve(thread_count);
+
+  try
+  {
+    for (std::size_t i = 1; i < thread_count; ++i)
+    {
+      threads.emplace_back(guarded, i);
+    }
+  } catch (...)
+  {
+    // If we couldn't start a thread, don't leave the ones we did start running
+    for (auto &thread : threads)
+    {
+      thread.join();
+    }
+
+    throw;
+  }
+
+  guarded(0);
+
+  for (auto &thread : threads)
+  {
+    thread.join();
+  }
+
+  for (auto const &error : errors)
+  {
+    if (error)
+    {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+} // namespace hmr::parallel
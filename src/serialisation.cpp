@@ -1,27 +1,238 @@
 #include "hamarr/serialisation.hpp"
 
 #include <algorithm>
+#include <array>
+#include <limits>
+#include <cstring>
+#include <stdexcept>
+#include <unordered_set>
 #include <vector>
 
 #include "hamarr/format.hpp"
+#include "hamarr/url.hpp"
 #include "hamarr/exceptions.hpp"
 
 namespace hmr::kvp
 {
 
+namespace
+{
+
+////////////////////////////////////////////////////////////
+auto piece_size(std::string_view piece, bool url_encode) noexcept -> std::size_t
+{
+  return url_encode ? hmr::url::encoded_size(piece) : piece.size();
+}
+
+
+////////////////////////////////////////////////////////////
+auto write_piece(std::string_view piece, bool url_encode, char *out) noexcept -> char *
+{
+  if (url_encode)
+  {
+    return hmr::url::encode_into(piece, out);
+  }
+
+  std::memcpy(out, piece.data(), piece.size());
+  return out + piece.size();
+}
+
+
+// The binary format starts with this, then a flags byte and the number of pairs as a varint, then the index (if there is one), then the pairs
+constexpr auto binary_magic = std::array<char, 4>{'H', 'K', 'V', '\x01'}; // The last byte is the format version
+constexpr auto binary_indexed = 0x01;
+constexpr auto binary_wide_index = 0x02; // 8-byte rather than 4-byte offsets
+
+
+////////////////////////////////////////////////////////////
+auto varint_size(std::size_t value) noexcept -> std::size_t
+{
+  auto size = std::size_t{1};
+
+  for (; value >= 0x80; value >>= 7)
+  {
+    ++size;
+  }
+
+  return size;
+}
+
+
+////////////////////////////////////////////////////////////
+auto write_varint(std::size_t value, char *out) noexcept -> char *
+{
+  // Seven bits at a time, least significant first, with the top bit set on every byte bar the last
+  for (; value >= 0x80; value >>= 7)
+  {
+    *out++ = static_cast<char>((value & 0x7F) | 0x80);
+  }
+
+  *out++ = static_cast<char>(value);
+  return out;
+}
+
+
+////////////////////////////////////////////////////////////
+auto read_varint(char const *&pos, char const *last) -> std::size_t
+{
+  constexpr auto bits = std::numeric_limits<std::size_t>::digits;
+
+  auto value = std::size_t{0};
+
+  for (auto shift = 0; pos != last; shift += 7)
+  {
+    auto const byte = static_cast<unsigned char>(*pos++);
+    auto const payload = static_cast<std::size_t>(byte & 0x7F);
+
+    if (shift >= bits || (shift > bits - 7 && (payload >> (bits - shift)) != 0))
+    {
+      throw hmr::xcpt::kvp::parse_error("Varint too large in binary kvp input!");
+    }
+
+    value |= payload << shift;
+
+    if ((byte & 0x80) == 0)
+    {
+      return value;
+    }
+  }
+
+  throw hmr::xcpt::kvp::parse_error("Truncated binary kvp input!");
+}
+
+
+////////////////////////////////////////////////////////////
+// The first item in a vector of pairs sorted by key whose key isn't less than the given one, for both const and non-const vectors
+template<typename Items>
+auto lower_bound_by_key(Items &items, std::string_view key) noexcept
+{
+  return std::lower_bound(items.begin(), items.end(), key, [](auto const &item, std::string_view k) { return item.first < k; });
+}
+
+} // namespace
+
+
 ////////////////////////////////////////////////////////////
-auto serialise(kvps const &input, char kv_delimiter, char kvp_delimiter) -> std::string
+auto serialise(kvps const &input, char kv_delimiter, char kvp_delimiter, bool url_encode) -> std::string
 {
   auto output = std::string{};
+  serialise(input, output, kv_delimiter, kvp_delimiter, url_encode);
+
+  return output;
+}
+
+
+////////////////////////////////////////////////////////////
+auto serialise(kvps const &input, std::string &output, char kv_delimiter, char kvp_delimiter, bool url_encode) -> void
+{
+  if (input.empty())
+  {
+    return;
+  }
+
+  // First pass - work out exactly how much room we need, i.e. each key and value plus a delimiter after each of them, bar the last one
+  auto size = (input.size() * 2) - 1;
+
+  for (auto const &[key, value] : input)
+  {
+    size += piece_size(key, url_encode) + piece_size(value, url_encode);
+  }
+
+  // Second pass - write everything straight into the output
+  auto const offset = output.size();
+  output.resize(offset + size);
 
-  for (auto const &kvp : input)
+  auto *out = output.data() + offset;
+
+  for (auto const &[key, value] : input)
   {
-    auto tmp = std::string{kvp.first} + kv_delimiter + std::string{kvp.second} + kvp_delimiter;
-    output += tmp;
+    if (out != output.data() + offset)
+    {
+      *out++ = kvp_delimiter;
+    }
+
+    out = write_piece(key, url_encode, out);
+    *out++ = kv_delimiter;
+    out = write_piece(value, url_encode, out);
   }
+}
 
-  // Pop the final delimiter char off the end of the string
-  output.pop_back();
+
+////////////////////////////////////////////////////////////
+auto serialise(kvps const &input, std::ostream &output, char kv_delimiter, char kvp_delimiter, bool url_encode) -> void
+{
+  auto encoded = std::string{}; // Reused for every key and value, so it only needs to grow a few times
+
+  auto write = [&output, &encoded, url_encode](std::string_view piece)
+  {
+    if (url_encode)
+    {
+      encoded.resize(hmr::url::encoded_size(piece));
+      hmr::url::encode_into(piece, encoded.data());
+      piece = encoded;
+    }
+
+    output.write(piece.data(), static_cast<std::streamsize>(piece.size()));
+  };
+
+  auto first = true;
+
+  for (auto const &[key, value] : input)
+  {
+    if (!first)
+    {
+      output.put(kvp_delimiter);
+    }
+
+    write(key);
+    output.put(kv_delimiter);
+    write(value);
+
+    first = false;
+  }
+}
+
+
+////////////////////////////////////////////////////////////
+auto serialise_binary(kvps const &input, bool with_index) -> std::string
+{
+  // First pass - work out exactly how big everything will be, including whether the index needs 8-byte offsets
+  auto records_size = std::size_t{0};
+
+  for (auto const &[key, value] : input)
+  {
+    records_size += varint_size(key.size()) + key.size() + varint_size(value.size()) + value.size();
+  }
+
+  auto const wide = (records_size > 0xFFFFFFFF);
+  auto const offset_width = with_index ? (wide ? std::size_t{8} : std::size_t{4}) : std::size_t{0};
+  auto const header_size = binary_magic.size() + 1 + varint_size(input.size());
+
+  // Second pass - write it all straight into place
+  auto output = std::string(header_size + (input.size() * offset_width) + records_size, '\0');
+  auto *out = std::copy(binary_magic.begin(), binary_magic.end(), output.data());
+
+  *out++ = static_cast<char>((with_index ? binary_indexed : 0) | (with_index && wide ? binary_wide_index : 0));
+  out = write_varint(input.size(), out);
+
+  auto *index = out;
+  auto *const records = out + (input.size() * offset_width);
+  out = records;
+
+  for (auto const &[key, value] : input)
+  {
+    auto const offset = static_cast<std::size_t>(out - records);
+
+    for (auto i = std::size_t{0}; i < offset_width; ++i)
+    {
+      *index++ = static_cast<char>((offset >> (i * 8)) & 0xFF);
+    }
+
+    out = write_varint(key.size(), out);
+    out = std::copy(key.begin(), key.end(), out);
+    out = write_varint(value.size(), out);
+    out = std::copy(value.begin(), value.end(), out);
+  }
 
   return output;
 }
@@ -32,23 +243,601 @@ auto deserialise(std::string_view input, char kv_delimiter, char kvp_delimiter)
 {
   auto output = kvps{};
 
-  // First divide the input up into groups of pairs by splitting around the kvp_delimiter
-  auto const pairs = hmr::fmt::split(input, kvp_delimiter);
+  for (auto const &[key, value] : deserialise_view(input, kv_delimiter, kvp_delimiter))
+  {
+    output[std::string{key}] = value;
+  }
+
+  return output;
+}
+
+
+////////////////////////////////////////////////////////////
+auto deserialise(std::string_view input, intern_pool &pool, char kv_delimiter, char kvp_delimiter) -> interned_kvps
+{
+  auto output = interned_kvps{};
+
+  for_each_pair(input, [&](std::string_view key, std::string_view value) { output.insert_or_assign(pool.intern(key), std::string{value}); }, kv_delimiter, kvp_delimiter);
+
+  return output;
+}
+
 
-  // Now divide each group into a key-value pair and add to the output map
-  for (auto const &pair : pairs)
+////////////////////////////////////////////////////////////
+auto deserialise_binary(std::string_view input) -> kvps
+{
+  auto output = kvps{};
+
+  // The pairs are already in key order, so each one belongs at the end
+  for (auto const &[key, value] : binary_view{input})
   {
-    auto key_value_pair = hmr::fmt::split(pair, kv_delimiter);
+    output.emplace_hint(output.end(), key, value);
+  }
+
+  return output;
+}
+
+
+////////////////////////////////////////////////////////////
+auto deserialise_view(std::string_view input, char kv_delimiter, char kvp_delimiter) -> kvp_views
+{
+  auto output = kvp_views{};
+
+  for_each_pair(input, [&output](std::string_view key, std::string_view value) { output.emplace_back(key, value); }, kv_delimiter, kvp_delimiter);
 
-    if (key_value_pair.size() != 2)
+  return output;
+}
+
+
+////////////////////////////////////////////////////////////
+auto split_pair(std::string_view pair, char kv_delimiter) -> std::pair<std::string_view, std::string_view>
+{
+  auto const parts = hmr::fmt::split_view(pair, kv_delimiter);
+
+  auto it = parts.begin();
+  auto const key = (it != parts.end()) ? *it++ : std::string_view{};
+  auto const value = (it != parts.end()) ? *it++ : std::string_view{};
+
+  if (key.empty() || value.empty() || it != parts.end())
+  {
+    throw hmr::xcpt::kvp::parse_error("Failed to split into a single key-value pair!");
+  }
+
+  return {key, value};
+}
+
+
+////////////////////////////////////////////////////////////
+auto deserialise_into(flat_kvps &output, std::string_view input, char kv_delimiter, char kvp_delimiter) -> void
+{
+  auto const views = deserialise_view(input, kv_delimiter, kvp_delimiter);
+
+  // An empty map can be built in one go, sorting once rather than shuffling the vector along on every insertion
+  if (output.empty())
+  {
+    output = flat_kvps{views};
+    return;
+  }
+
+  for (auto const &[key, value] : views)
+  {
+    output.insert_or_assign(key, value);
+  }
+}
+
+
+////////////////////////////////////////////////////////////
+flat_kvps::flat_kvps(kvp_views const &views)
+{
+  // Sort copies of the views rather than the strings themselves, keeping duplicates in input order so that the last of each run is the one kept
+  auto sorted = std::vector<std::pair<std::string_view, std::string_view>>(views.begin(), views.end());
+  std::stable_sort(sorted.begin(), sorted.end(), [](auto const &lhs, auto const &rhs) { return lhs.first < rhs.first; });
+
+  items_.reserve(sorted.size());
+
+  for (auto it = sorted.begin(); it != sorted.end(); ++it)
+  {
+    auto const next = std::next(it);
+
+    if (next == sorted.end() || next->first != it->first)
     {
-      throw hmr::xcpt::kvp::parse_error("Failed to split into a single key-value pair!");
+      items_.emplace_back(it->first, it->second);
     }
+  }
+}
+
 
-    output[key_value_pair[0]] = key_value_pair[1];
+////////////////////////////////////////////////////////////
+auto flat_kvps::find(std::string_view key) const noexcept -> const_iterator
+{
+  auto const it = lower_bound_by_key(items_, key);
+  return (it != items_.end() && it->first == key) ? it : items_.end();
+}
+
+
+////////////////////////////////////////////////////////////
+auto flat_kvps::at(std::string_view key) -> std::string &
+{
+  auto const it = lower_bound_by_key(items_, key);
+
+  if (it == items_.end() || it->first != key)
+  {
+    throw std::out_of_range("Key not found in flat_kvps!");
   }
 
-  return output;
+  return it->second;
+}
+
+
+////////////////////////////////////////////////////////////
+auto flat_kvps::at(std::string_view key) const -> std::string const &
+{
+  auto const it = find(key);
+
+  if (it == end())
+  {
+    throw std::out_of_range("Key not found in flat_kvps!");
+  }
+
+  return it->second;
+}
+
+
+////////////////////////////////////////////////////////////
+auto flat_kvps::operator[](std::string_view key) -> std::string &
+{
+  auto it = lower_bound_by_key(items_, key);
+
+  if (it == items_.end() || it->first != key)
+  {
+    it = items_.emplace(it, std::string{key}, std::string{});
+  }
+
+  return it->second;
+}
+
+
+////////////////////////////////////////////////////////////
+auto flat_kvps::insert_or_assign(std::string_view key, std::string_view value) -> void
+{
+  (*this)[key] = value;
+}
+
+
+////////////////////////////////////////////////////////////
+key_filter::key_filter(std::initializer_list<std::string_view> keys) : key_filter(std::vector<std::string_view>(keys))
+{
+}
+
+
+////////////////////////////////////////////////////////////
+key_filter::key_filter(std::vector<std::string_view> const &keys)
+{
+  auto seen = std::unordered_set<std::string_view>{};
+
+  for (auto const key : keys)
+  {
+    if (seen.insert(key).second)
+    {
+      keys_.emplace_back(key);
+    }
+  }
+
+  // The build only fails if two keys hash identically, which another key hash seed all but certainly fixes
+  while (!try_build())
+  {
+    ++seed_;
+  }
+}
+
+
+////////////////////////////////////////////////////////////
+auto key_filter::try_build() -> bool
+{
+  // About two keys per bucket, and a table at most half full, both rounded up to a power of two so that masks can stand in for modulos
+  auto bucket_count = std::size_t{1};
+  auto slot_count = std::size_t{2};
+
+  while (bucket_count * 2 < keys_.size())
+  {
+    bucket_count *= 2;
+  }
+
+  while (slot_count < keys_.size() * 2)
+  {
+    slot_count *= 2;
+  }
+
+  auto hashes = std::vector<std::uint64_t>(keys_.size());
+  auto buckets = std::vector<std::vector<std::uint32_t>>(bucket_count);
+
+  for (auto i = std::size_t{0}; i < keys_.size(); ++i)
+  {
+    hashes[i] = hash_of(keys_[i]);
+    buckets[hashes[i] & (bucket_count - 1)].push_back(static_cast<std::uint32_t>(i));
+  }
+
+  // Placing the biggest buckets first, while the table is still mostly empty, keeps every bucket's search for a seed short
+  auto order = std::vector<std::uint32_t>(bucket_count);
+
+  for (auto b = std::size_t{0}; b < bucket_count; ++b)
+  {
+    order[b] = static_cast<std::uint32_t>(b);
+  }
+
+  std::stable_sort(order.begin(), order.end(), [&buckets](auto lhs, auto rhs) { return buckets[lhs].size() > buckets[rhs].size(); });
+
+  slots_.assign(slot_count, 0);
+  seeds_.assign(bucket_count, 0);
+
+  auto placed = std::vector<std::size_t>{};
+
+  for (auto const b : order)
+  {
+    auto const &bucket = buckets[b];
+
+    if (bucket.empty())
+    {
+      break;
+    }
+
+    // With the table at most half full, a bucket of k keys fits with probability of at least 2^-k per seed. Far more attempts than that
+    // means two of its keys can't be separated by any seed
+    for (auto seed = std::uint32_t{0}; ; ++seed)
+    {
+      if (seed == (std::uint32_t{1} << 16))
+      {
+        return false;
+      }
+
+      placed.clear();
+
+      for (auto const i : bucket)
+      {
+        auto const slot = slot_of(hashes[i], seed);
+
+        if (slots_[slot] != 0)
+        {
+          break;
+        }
+
+        slots_[slot] = i + 1;
+        placed.push_back(slot);
+      }
+
+      if (placed.size() == bucket.size())
+      {
+        seeds_[b] = seed;
+        break;
+      }
+
+      for (auto const slot : placed)
+      {
+        slots_[slot] = 0;
+      }
+    }
+  }
+
+  return true;
+}
+
+
+////////////////////////////////////////////////////////////
+auto key_filter::index_of(std::string_view key) const noexcept -> std::size_t
+{
+  auto const hash = hash_of(key);
+  auto const index = slots_[slot_of(hash, seeds_[hash & (seeds_.size() - 1)])];
+
+  // A key that isn't in the set can still land in an occupied slot, so the key stored there has to be checked too
+  return (index != 0 && keys_[index - 1] == key) ? index - 1 : npos;
+}
+
+
+////////////////////////////////////////////////////////////
+auto key_filter::hash_of(std::string_view key) const noexcept -> std::uint64_t
+{
+  // Seeded FNV-1a
+  auto hash = 0xcbf29ce484222325 ^ (seed_ * 0x9e3779b97f4a7c15);
+
+  for (auto const c : key)
+  {
+    hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3;
+  }
+
+  return hash;
+}
+
+
+////////////////////////////////////////////////////////////
+auto key_filter::slot_of(std::uint64_t hash, std::uint32_t seed) const noexcept -> std::size_t
+{
+  // The splitmix64 finaliser, so that the slot doesn't depend on the low bits which picked the bucket
+  hash += (seed + 1) * 0x9e3779b97f4a7c15;
+  hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9;
+  hash = (hash ^ (hash >> 27)) * 0x94d049bb133111eb;
+  hash ^= hash >> 31;
+
+  return hash & (slots_.size() - 1);
+}
+
+
+////////////////////////////////////////////////////////////
+auto parse_batch(std::vector<std::string_view> const &inputs, char kv_delimiter, char kvp_delimiter) -> kvp_table
+{
+  auto table = kvp_table{};
+
+  // The column used for each position in the previous row. When the records all share a layout, each key only needs comparing to the key
+  // of its predicted column rather than being looked up
+  auto predicted = std::vector<std::size_t>{};
+
+  for (auto const input : inputs)
+  {
+    auto const row = table.rows_++;
+
+    for (auto &column : table.columns_)
+    {
+      column.emplace_back();
+    }
+
+    auto position = std::size_t{0};
+
+    for_each_pair(input, [&](std::string_view key, std::string_view value)
+    {
+      auto index = (position < predicted.size()) ? predicted[position] : kvp_table::npos;
+
+      if (index == kvp_table::npos || table.keys_[index] != key)
+      {
+        index = table.add_column(key);
+
+        if (position < predicted.size())
+        {
+          predicted[position] = index;
+        } else
+        {
+          predicted.push_back(index);
+        }
+      }
+
+      table.columns_[index][row] = value;
+      ++position;
+    }, kv_delimiter, kvp_delimiter);
+  }
+
+  return table;
+}
+
+
+////////////////////////////////////////////////////////////
+auto kvp_table::column_index(std::string_view key) const noexcept -> std::size_t
+{
+  auto const it = index_.find(key);
+  return (it == index_.end()) ? npos : it->second;
+}
+
+
+////////////////////////////////////////////////////////////
+auto kvp_table::column(std::string_view key) const -> std::vector<std::string_view> const &
+{
+  auto const index = column_index(key);
+
+  if (index == npos)
+  {
+    throw std::out_of_range("Key not found in kvp_table!");
+  }
+
+  return columns_[index];
+}
+
+
+////////////////////////////////////////////////////////////
+auto kvp_table::add_column(std::string_view key) -> std::size_t
+{
+  auto const [it, inserted] = index_.try_emplace(std::string{key}, keys_.size());
+
+  // A new column is created for the row being parsed, so it has to be padded out with empty values for the rows before it
+  if (inserted)
+  {
+    keys_.emplace_back(key);
+    columns_.emplace_back(rows_);
+  }
+
+  return it->second;
+}
+
+
+////////////////////////////////////////////////////////////
+auto intern_pool::intern(std::string_view string) -> handle
+{
+  if (auto const it = index_.find(string); it != index_.end())
+  {
+    return handle{it->second};
+  }
+
+  auto const &stored = strings_.emplace_back(string);
+  index_.emplace(stored, &stored);
+
+  return handle{&stored};
+}
+
+
+////////////////////////////////////////////////////////////
+auto intern_pool::find(std::string_view string) const noexcept -> handle
+{
+  auto const it = index_.find(string);
+  return (it == index_.end()) ? handle{} : handle{it->second};
+}
+
+
+////////////////////////////////////////////////////////////
+binary_view::binary_view(std::string_view input) : last_(input.data() + input.size())
+{
+  if (input.size() <= binary_magic.size() || !std::equal(binary_magic.begin(), binary_magic.end(), input.begin()))
+  {
+    throw hmr::xcpt::kvp::parse_error("Input isn't in the binary kvp format!");
+  }
+
+  auto const flags = static_cast<unsigned char>(input[binary_magic.size()]);
+
+  if ((flags & ~(binary_indexed | binary_wide_index)) != 0)
+  {
+    throw hmr::xcpt::kvp::parse_error("Unsupported flags in binary kvp input!");
+  }
+
+  auto const *pos = input.data() + binary_magic.size() + 1;
+  count_ = read_varint(pos, last_);
+
+  if ((flags & binary_indexed) != 0)
+  {
+    offset_width_ = ((flags & binary_wide_index) != 0) ? 8 : 4;
+
+    if (count_ > static_cast<std::size_t>(last_ - pos) / offset_width_)
+    {
+      throw hmr::xcpt::kvp::parse_error("Truncated binary kvp input!");
+    }
+
+    index_ = reinterpret_cast<unsigned char const *>(pos);
+    pos += count_ * offset_width_;
+  }
+
+  // Every pair takes at least two bytes, for its key and value lengths
+  if (count_ > static_cast<std::size_t>(last_ - pos) / 2)
+  {
+    throw hmr::xcpt::kvp::parse_error("Truncated binary kvp input!");
+  }
+
+  records_ = pos;
+}
+
+
+////////////////////////////////////////////////////////////
+auto binary_view::find(std::string_view key) const -> iterator
+{
+  if (index_ == nullptr)
+  {
+    // The pairs are in key order, so the scan can stop as soon as it has gone past where the key would be
+    for (auto it = begin(); it != end(); ++it)
+    {
+      if (it->first >= key)
+      {
+        return (it->first == key) ? it : end();
+      }
+    }
+
+    return end();
+  }
+
+  auto low = std::size_t{0};
+  auto high = count_;
+
+  while (low < high)
+  {
+    auto const middle = low + ((high - low) / 2);
+
+    if (pair_at(middle)->first < key)
+    {
+      low = middle + 1;
+    } else
+    {
+      high = middle;
+    }
+  }
+
+  if (low == count_)
+  {
+    return end();
+  }
+
+  auto it = pair_at(low);
+  return (it->first == key) ? it : end();
+}
+
+
+////////////////////////////////////////////////////////////
+auto binary_view::at(std::string_view key) const -> std::string_view
+{
+  auto const it = find(key);
+
+  if (it == end())
+  {
+    throw std::out_of_range("Key not found in binary_view!");
+  }
+
+  return it->second;
+}
+
+
+////////////////////////////////////////////////////////////
+auto binary_view::pair_at(std::size_t index) const -> iterator
+{
+  auto const *entry = index_ + (index * offset_width_);
+  auto offset = std::size_t{0};
+
+  for (auto i = std::size_t{0}; i < offset_width_; ++i)
+  {
+    offset |= static_cast<std::size_t>(entry[i]) << (i * 8);
+  }
+
+  if (offset >= static_cast<std::size_t>(last_ - records_))
+  {
+    throw hmr::xcpt::kvp::parse_error("Invalid offset in binary kvp index!");
+  }
+
+  return iterator{records_ + offset, last_, count_ - index};
+}
+
+
+////////////////////////////////////////////////////////////
+binary_view::iterator::iterator(char const *first, char const *last, std::size_t remaining) : next_(first), last_(last), remaining_(remaining)
+{
+  if (remaining_ != 0)
+  {
+    decode();
+  }
+}
+
+
+////////////////////////////////////////////////////////////
+auto binary_view::iterator::operator++() -> iterator &
+{
+  if (--remaining_ != 0)
+  {
+    decode();
+  }
+
+  return *this;
+}
+
+
+////////////////////////////////////////////////////////////
+auto binary_view::iterator::operator++(int) -> iterator
+{
+  auto const it = *this;
+  ++(*this);
+
+  return it;
+}
+
+
+////////////////////////////////////////////////////////////
+auto binary_view::iterator::decode() -> void
+{
+  auto read = [this]
+  {
+    auto const length = read_varint(next_, last_);
+
+    if (length > static_cast<std::size_t>(last_ - next_))
+    {
+      throw hmr::xcpt::kvp::parse_error("Truncated binary kvp input!");
+    }
+
+    auto const piece = std::string_view{next_, length};
+    next_ += length;
+
+    return piece;
+  };
+
+  pair_.first = read();
+  pair_.second = read();
 }
 
 } // namespace hmr::kvp
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+
+// The SIMD code paths are selected at compile time. SSE2 is part of the x86-64 baseline, but anything beyond that requires building with the
+// appropriate flags, e.g. by enabling the ENABLE_HAMARR_NATIVE_ARCH CMake option. Everything falls back to portable scalar code otherwise
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HMR_SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__SSSE3__) || defined(__AVX__)
+#define HMR_SIMD_SSSE3 1
+#include <tmmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#define HMR_SIMD_AVX2 1
+#include <immintrin.h>
+#endif
+
+#if defined(__PCLMUL__)
+#define HMR_SIMD_PCLMUL 1
+#include <wmmintrin.h>
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace hmr::simd
+{
+
+////////////////////////////////////////////////////////////
+// Index of the lowest set bit - the mask must not be zero
+inline auto trailing_zeros(uint32_t mask) noexcept -> unsigned
+{
+#if defined(_MSC_VER)
+  unsigned long index = 0;
+  _BitScanForward(&index, mask);
+  return static_cast<unsigned>(index);
+#else
+  return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+
+////////////////////////////////////////////////////////////
+// Index of the lowest set bit - the mask must not be zero
+inline auto trailing_zeros(uint64_t mask) noexcept -> unsigned
+{
+#if defined(_MSC_VER)
+  unsigned long index = 0;
+  _BitScanForward64(&index, mask);
+  return static_cast<unsigned>(index);
+#else
+  return static_cast<unsigned>(__builtin_ctzll(mask));
+#endif
+}
+
+
+////////////////////////////////////////////////////////////
+// Each output bit is the XOR of that input bit and every bit below it, e.g. turning a mask of quote chars into a mask of what lies between them
+inline auto prefix_xor(uint64_t bits) noexcept -> uint64_t
+{
+#if defined(HMR_SIMD_PCLMUL)
+  // A carry-less multiply by all ones does the whole thing in one instruction
+  auto const product = _mm_clmulepi64_si128(_mm_set_epi64x(0, static_cast<long long>(bits)), _mm_set1_epi8(-1), 0);
+  return static_cast<uint64_t>(_mm_cvtsi128_si64(product));
+#else
+  bits ^= bits << 1;
+  bits ^= bits << 2;
+  bits ^= bits << 4;
+  bits ^= bits << 8;
+  bits ^= bits << 16;
+  bits ^= bits << 32;
+
+  return bits;
+#endif
+}
+
+} // namespace hmr::simd
@@ -1,6 +1,8 @@
 #include "hamarr/url.hpp"
 
 #include <algorithm>
+#include <array>
+#include <cstring>
 #include <sstream>
 
 #include "hamarr/hex.hpp"
@@ -9,142 +11,563 @@
 namespace hmr::url
 {
 
+namespace
+{
+
+// Lookup table mapping each byte to its value as a hex char, or 0xFF if it isn't a valid hex char
+constexpr auto hex_values = []
+{
+  auto table = std::array<uint8_t, 256>{};
+
+  for (auto &value : table)
+  {
+    value = 0xFF;
+  }
+
+  for (uint8_t i = 0; i < 10; ++i)
+  {
+    table['0' + i] = i;
+  }
+
+  for (uint8_t i = 0; i < 6; ++i)
+  {
+    table['A' + i] = 10 + i;
+    table['a' + i] = 10 + i;
+  }
+
+  return table;
+}();
+
+
+// Lookup table built from unreserved_chars, so that checking whether a char needs encoding doesn't require a search
+constexpr auto unreserved_table = []
+{
+  auto table = std::array<bool, 256>{};
+
+  for (auto const c : unreserved_chars)
+  {
+    table[static_cast<uint8_t>(c)] = true;
+  }
+
+  return table;
+}();
+
+
 ////////////////////////////////////////////////////////////
-auto encode(std::string_view input, bool lazy) noexcept -> std::string
+constexpr auto is_valid_hex(char c) noexcept -> bool
+{
+  return hex_values[static_cast<uint8_t>(c)] != 0xFF;
+}
+
+
+////////////////////////////////////////////////////////////
+constexpr auto hex_pair(char hi, char lo) noexcept -> char
 {
-  auto output = std::string{};
-  output.reserve(input.size()); // The output will almost certainly be larger than this, however...
+  return static_cast<char>((hex_values[static_cast<uint8_t>(hi)] << 4) | hex_values[static_cast<uint8_t>(lo)]);
+}
 
-  for (auto const &c : input)
+
+////////////////////////////////////////////////////////////
+// Percent-decodes input into out, returning a pointer one past the last char written. The output is never longer than the input
+auto decode_into(std::string_view input, bool lazy, bool plus_as_space, char *out) -> char *
+{
+  auto const len = input.size();
+
+  for (std::size_t i = 0; i < len; ++i)
   {
-    // Is it an unreserved char? If so, append unchanged
-    if (unreserved_chars.find(c) != std::string_view::npos)
+    // Regular characters are copied across unchanged (apart from '+' in form-urlencoded data)
+    if (input[i] != '%')
     {
-      output.push_back(c);
+      *out++ = (plus_as_space && input[i] == '+') ? ' ' : input[i];
       continue;
     }
 
-    // If we get to here, then it must be a reserved char
-    if (lazy) // If we're being lazy, just convert to hex and append
+    if (i + 2 >= len) // Need room for at least 2 more chars
     {
-      output += ("%" + hmr::hex::encode(c));
+      throw hmr::xcpt::url::need_more_data("Not enough chars remaining to parse escape sequence!");
+    }
 
-    } else // If not lazy, convert to UTF8 first and then append
+    // If we're not being lazy, check for a %C2 or %C3 two-byte UTF-8 sequence
+    if (!lazy && input[i + 1] == 'C')
     {
-      if (static_cast<uint8_t>(c) < 0x80) // Char values less than 0x80 remain unchanged
+      // Abort condition - need room for 5 more chars
+      if (i + 5 >= len)
+      {
+        throw hmr::xcpt::url::need_more_data("Not enough chars remaining to parse two-byte UTF-8 escape sequence - expected 5 but only " + std::to_string(len - i) + " left!");
+      }
+
+      // Abort condition - of the following 5 chars, the 1st, 2nd, 4th and 5th must be valid hex chars
+      if (!is_valid_hex(input[i + 1]) || !is_valid_hex(input[i + 2]) || !is_valid_hex(input[i + 4]) || !is_valid_hex(input[i + 5]))
       {
-        output += ("%" + hmr::hex::encode(c));
+        auto ss = std::stringstream{};
+        ss << "Invalid two-byte UTF-8 hex escape sequence: " << input.substr(i, 6);
+        throw hmr::xcpt::url::invalid_input(ss.str());
+      }
 
-      } else if (static_cast<uint8_t>(c) >= 0x80 && static_cast<uint8_t>(c) < 0xC0)
+      if (input[i + 2] == '2')
       {
-        output += ("%C2%" + hmr::hex::encode(c));
+        *out++ = hex_pair(input[i + 4], input[i + 5]);
 
-      } else if (static_cast<uint8_t>(c) >= 0xC0)
+      } else if (input[i + 2] == '3')
       {
-        output += ("%C3%" + hmr::hex::encode(static_cast<uint8_t>(c ^ 0x40))); // Casting to uint8_t is necessary because, even though c is a char, c ^ 40 produces an int, which is not just a single byte, so the hex::encode() function messes it up
+        *out++ = static_cast<char>(static_cast<uint8_t>(hex_pair(input[i + 4], input[i + 5])) | 0x40);
 
-      } else // This shouldn't happen
+      } else
       {
-        return std::string{};
+        auto ss = std::stringstream{};
+        ss << "No valid UTF-8 -> ASCII conversion for two-byte hex escape sequences starting: " << input.substr(i, 3);
+        throw hmr::xcpt::url::invalid_input(ss.str());
       }
+
+      i += 5;
+      continue;
+    }
+
+    // Otherwise just convert back from hex - abort if they aren't valid hex chars
+    if (!is_valid_hex(input[i + 1]) || !is_valid_hex(input[i + 2]))
+    {
+      auto ss = std::stringstream{};
+      ss << "Invalid hex escape sequence: " << input.substr(i, 3);
+      throw hmr::xcpt::url::invalid_input(ss.str());
     }
+
+    *out++ = hex_pair(input[i + 1], input[i + 2]);
+    i += 2;
   }
 
-  return output;
+  return out;
 }
 
-
 ////////////////////////////////////////////////////////////
-auto decode(std::string_view input, bool lazy) -> std::string
+constexpr auto ascii_lower(char c) noexcept -> char
 {
-  auto const len = input.size();
+  return (c >= 'A' && c <= 'Z') ? static_cast<char>(c | 0x20) : c;
+}
 
-  auto output = std::string{};
-  output.reserve(len); // If there are any percent-encoded elements then we'll actually need less space, but over-reserving probably hurts less than under-reserving
 
-  auto is_valid_hex = [](uint8_t c) -> bool
-  { return std::isxdigit(c) != 0; };
+////////////////////////////////////////////////////////////
+// Copies input to out, decoding any escaped unreserved chars and uppercasing the hex digits of all other escapes. Malformed escapes are copied unchanged
+auto normalise_percent_encoding(std::string_view input, char *out, bool lowercase) noexcept -> char *
+{
+  auto const len = input.size();
 
   for (std::size_t i = 0; i < len; ++i)
   {
-    // Is this an escape sequence?
-    if (input[i] == '%')
+    if (input[i] == '%' && i + 2 < len && is_valid_hex(input[i + 1]) && is_valid_hex(input[i + 2]))
     {
-      if (i + 2 >= len) // Need room for at least 2 more chars
+      auto const ch = static_cast<uint8_t>(hex_pair(input[i + 1], input[i + 2]));
+
+      if (unreserved_table[ch])
+      {
+        *out++ = lowercase ? ascii_lower(static_cast<char>(ch)) : static_cast<char>(ch);
+      } else
       {
-        throw hmr::xcpt::url::need_more_data("Not enough chars remaining to parse escape sequence!");
+        *out++ = '%';
+        *out++ = hmr::hex::hex_alphabet[ch >> 4];
+        *out++ = hmr::hex::hex_alphabet[ch & 0x0F];
       }
 
-      if (lazy) // Are we being lazy? If so, just convert back from hex and append
+      i += 2;
+    } else
+    {
+      *out++ = lowercase ? ascii_lower(input[i]) : input[i];
+    }
+  }
+
+  return out;
+}
+
+
+////////////////////////////////////////////////////////////
+// Removes any "." and ".." segments from the path in [first, last) in place, as per RFC 3986 section 5.2.4, returning the new end of the path
+auto remove_dot_segments(char *first, char *last) noexcept -> char *
+{
+  char *out = first;
+  char const *in = first;
+
+  // Never remove the leading slash of an absolute path
+  char *root = first;
+  if (in != last && *in == '/')
+  {
+    ++in;
+    ++out;
+    ++root;
+  }
+
+  // We only ever write what we've already read, so out can never overtake in
+  while (in != last)
+  {
+    char const *segment_end = std::find(in, static_cast<char const *>(last), '/');
+    bool const has_slash = (segment_end != last);
+    auto const segment_len = static_cast<std::size_t>(segment_end - in);
+
+    if (segment_len == 2 && in[0] == '.' && in[1] == '.')
+    {
+      // Step back over the trailing slash and the previous segment
+      if (out != root)
       {
-        // Abort condition - expect valid hex chars
-        if (!is_valid_hex(input[i + 1]) || !is_valid_hex(input[i + 2]))
+        --out;
+        while (out != root && out[-1] != '/')
         {
-          auto ss = std::stringstream{};
-          ss << "Invalid hex escape sequence: " << input.substr(i, 3);
-          throw hmr::xcpt::url::invalid_input(ss.str());
+          --out;
         }
+      }
 
-        output += hmr::hex::decode(std::string(input.data() + i + 1, 2));
-        i += 2;
-      } else
+    } else if (segment_len != 1 || in[0] != '.')
+    {
+      std::memmove(out, in, segment_len);
+      out += segment_len;
+
+      if (has_slash)
       {
-        // Otherwise check for a %C2 or %C3 two-byte UTF-8 sequence
-        if (input[i + 1] == 'C')
-        {
-          // Abort condition - need room for 5 more chars
-          if (i + 5 >= len)
-          {
-            throw hmr::xcpt::url::need_more_data("Not enough chars remaining to parse two-byte UTF-8 escape sequence - expected 5 but only " + std::to_string(len - i) + " left!");
-          }
-
-          // Abort condition - of the following 5 chars, the 1st, 2nd, 4th and 5th must be valid hex chars
-          if (!is_valid_hex(input[i + 1]) || !is_valid_hex(input[i + 2]) || !is_valid_hex(input[i + 4]) || !is_valid_hex(input[i + 5]))
-          {
-            auto ss = std::stringstream{};
-            ss << "Invalid two-byte UTF-8 hex escape sequence: " << input.substr(i, 6);
-            throw hmr::xcpt::url::invalid_input(ss.str());
-          }
-
-          if (input[i + 2] == '2')
-          {
-            auto adj = hmr::hex::decode(std::string(input.data() + i + 4, 2));
-            output += hmr::hex::decode(std::string(input.data() + i + 4, 2));
-
-          } else if (input[i + 2] == '3')
-          {
-            auto adj = static_cast<uint8_t>(hmr::hex::decode<uint8_t>(std::string(input.data() + i + 4, 2)) | 0x40);
-            output.push_back(adj);
-
-          } else
-          {
-            auto ss = std::stringstream{};
-            ss << "No valid UTF-8 -> ASCII conversion for two-byte hex escape sequences starting: " << input.substr(i, 3);
-            throw hmr::xcpt::url::invalid_input(ss.str());
-          }
-
-          i += 5;
-        } else // If it wasn't a %C2 or %C3 sequence, then just convert back from hex and append
-        {
-          // Abort condition - expect valid hex chars
-          if (!is_valid_hex(input[i + 1]) || !is_valid_hex(input[i + 2]))
-          {
-            auto ss = std::stringstream{};
-            ss << "Invalid hex escape sequence: " << input.substr(i, 3);
-            throw hmr::xcpt::url::invalid_input(ss.str());
-          }
-
-          output += hmr::hex::decode(std::string(input.data() + i + 1, 2));
-          i += 2;
-        }
+        *out++ = '/';
       }
-    } else // Otherwise it must be a regular character
+    }
+
+    in = has_slash ? segment_end + 1 : last;
+  }
+
+  return out;
+}
+
+
+////////////////////////////////////////////////////////////
+// Finds the ':' that terminates the scheme, if the input starts with one
+auto scheme_length(std::string_view input) noexcept -> std::size_t
+{
+  auto is_alpha = [](char c)
+  { return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z'); };
+
+  if (input.empty() || !is_alpha(input[0]))
+  {
+    return std::string_view::npos;
+  }
+
+  for (std::size_t i = 1; i < input.size(); ++i)
+  {
+    auto const c = input[i];
+
+    if (c == ':')
+    {
+      return i;
+    }
+
+    if (!is_alpha(c) && !(c >= '0' && c <= '9') && c != '+' && c != '-' && c != '.')
+    {
+      break;
+    }
+  }
+
+  return std::string_view::npos;
+}
+
+
+////////////////////////////////////////////////////////////
+auto is_default_port(std::string_view scheme, std::string_view port) noexcept -> bool
+{
+  static constexpr auto default_ports = std::array<std::pair<std::string_view, std::size_t>, 5>{{{"http", 80}, {"https", 443}, {"ws", 80}, {"wss", 443}, {"ftp", 21}}};
+
+  // An empty port is equivalent to the default port
+  if (port.empty())
+  {
+    return true;
+  }
+
+  std::size_t value = 0;
+  for (auto const c : port)
+  {
+    value = (value * 10) + static_cast<std::size_t>(c - '0');
+
+    if (value > 65535)
+    {
+      return false;
+    }
+  }
+
+  return std::any_of(std::begin(default_ports), std::end(default_ports), [&](auto const &entry)
+    { return entry.first == scheme && entry.second == value; });
+}
+
+
+// 64-bit FNV-1a
+constexpr uint64_t fnv1a_basis = 0xCBF29CE484222325;
+
+
+////////////////////////////////////////////////////////////
+// Continues an FNV-1a hash over [first, last), so it can be built up a piece at a time
+constexpr auto fnv1a(uint64_t hash, char const *first, char const *last) noexcept -> uint64_t
+{
+  for (; first != last; ++first)
+  {
+    hash ^= static_cast<uint8_t>(*first);
+    hash *= 0x100000001B3;
+  }
+
+  return hash;
+}
+
+} // namespace
+
+////////////////////////////////////////////////////////////
+auto encode(std::string_view input, bool lazy) noexcept -> std::string
+{
+  auto output = std::string(encoded_size(input, lazy), '\0');
+  encode_into(input, output.data(), lazy);
+
+  return output;
+}
+
+
+////////////////////////////////////////////////////////////
+auto encoded_size(std::string_view input, bool lazy) noexcept -> std::size_t
+{
+  std::size_t size = 0;
+
+  for (auto const &c : input)
+  {
+    auto const ch = static_cast<uint8_t>(c);
+
+    // Unreserved chars are unchanged, reserved chars become a %XX sequence, and non-ASCII chars become two of them unless we're being lazy
+    if (unreserved_table[ch])
+    {
+      size += 1;
+    } else if (lazy || ch < 0x80)
+    {
+      size += 3;
+    } else
+    {
+      size += 6;
+    }
+  }
+
+  return size;
+}
+
+
+////////////////////////////////////////////////////////////
+auto encode_into(std::string_view input, char *output, bool lazy) noexcept -> char *
+{
+  auto append_hex = [&output](uint8_t ch)
+  {
+    *output++ = '%';
+    *output++ = hmr::hex::hex_alphabet[ch >> 4];
+    *output++ = hmr::hex::hex_alphabet[ch & 0x0F];
+  };
+
+  for (auto const &c : input)
+  {
+    auto const ch = static_cast<uint8_t>(c);
+
+    // Is it an unreserved char? If so, append unchanged
+    if (unreserved_table[ch])
+    {
+      *output++ = c;
+      continue;
+    }
+
+    // If we get to here, then it must be a reserved char. If we're being lazy, or the char value is less than 0x80, just convert to hex and
+    // append - otherwise convert to UTF8 first
+    if (lazy || ch < 0x80)
+    {
+      append_hex(ch);
+    } else if (ch < 0xC0)
+    {
+      append_hex(0xC2);
+      append_hex(ch);
+    } else
+    {
+      append_hex(0xC3);
+      append_hex(static_cast<uint8_t>(ch ^ 0x40));
+    }
+  }
+
+  return output;
+}
+
+
+////////////////////////////////////////////////////////////
+auto decode(std::string_view input, bool lazy) -> std::string
+{
+  // If there are any percent-encoded elements then we'll actually need less space, so decode straight into a buffer the size of the input and trim it afterwards
+  auto output = std::string(input.size(), '\0');
+
+  auto const *end = decode_into(input, lazy, false, output.data());
+  output.resize(static_cast<std::size_t>(end - output.data()));
+
+  return output;
+}
+
+
+////////////////////////////////////////////////////////////
+auto parse_query(std::string_view input, char kv_delimiter, char kvp_delimiter, bool lazy) -> query
+{
+  auto output = query{};
+
+  // Ignore the leading '?' if we've been handed the query component straight out of a URL
+  if (!input.empty() && input.front() == '?')
+  {
+    input.remove_prefix(1);
+  }
+
+  auto const len = input.size();
+
+  // Decoding never makes anything longer, so an arena the size of the input is enough to hold every decoded key and value
+  output.arena = std::unique_ptr<char[]>(new char[len]);
+  output.pairs.reserve(static_cast<std::size_t>(std::count(std::begin(input), std::end(input), kvp_delimiter)) + 1);
+
+  char *out = output.arena.get();
+
+  std::size_t pos = 0;
+
+  while (pos < len)
+  {
+    auto end = input.find(kvp_delimiter, pos);
+    if (end == std::string_view::npos)
+    {
+      end = len;
+    }
+
+    auto const pair = input.substr(pos, end - pos);
+    pos = end + 1;
+
+    // Skip empty pairs, e.g. from "a=1&&b=2"
+    if (pair.empty())
     {
-      output.push_back(input[i]);
+      continue;
     }
+
+    // A pair without a kv_delimiter is a key with an empty value
+    auto const split_pos = pair.find(kv_delimiter);
+    auto const raw_key = pair.substr(0, split_pos);
+    auto const raw_value = (split_pos == std::string_view::npos) ? std::string_view{} : pair.substr(split_pos + 1);
+
+    char *key_start = out;
+    out = decode_into(raw_key, lazy, true, out);
+    auto const key = std::string_view{key_start, static_cast<std::size_t>(out - key_start)};
+
+    char *value_start = out;
+    out = decode_into(raw_value, lazy, true, out);
+    auto const value = std::string_view{value_start, static_cast<std::size_t>(out - value_start)};
+
+    output.pairs.emplace_back(key, value);
   }
 
   return output;
 }
 
+
+////////////////////////////////////////////////////////////
+auto canonicalise(std::string_view input, char *output) noexcept -> canonical_url
+{
+  auto const len = input.size();
+
+  char *out = output;
+  std::size_t pos = 0;
+
+  // The scheme is case insensitive, so lowercase it
+  auto scheme = std::string_view{};
+  auto const scheme_len = scheme_length(input);
+
+  if (scheme_len != std::string_view::npos)
+  {
+    std::transform(input.data(), input.data() + scheme_len, out, ascii_lower);
+    scheme = std::string_view{out, scheme_len};
+
+    out += scheme_len;
+    *out++ = ':';
+    pos = scheme_len + 1;
+  }
+
+  // Is there an authority component?
+  if (input.substr(pos, 2) == "//")
+  {
+    *out++ = '/';
+    *out++ = '/';
+    pos += 2;
+
+    auto authority_end = input.find_first_of("/?#", pos);
+    if (authority_end == std::string_view::npos)
+    {
+      authority_end = len;
+    }
+
+    auto authority = input.substr(pos, authority_end - pos);
+    pos = authority_end;
+
+    // Any userinfo is case sensitive, so only normalise the percent-encoding
+    auto const at = authority.rfind('@');
+    if (at != std::string_view::npos)
+    {
+      out = normalise_percent_encoding(authority.substr(0, at + 1), out, false);
+      authority.remove_prefix(at + 1);
+    }
+
+    // Split off the port, taking care not to confuse it with the colons of an IPv6 literal
+    auto host = authority;
+    auto port = std::string_view{};
+    bool has_port = false;
+
+    auto const colon = authority.rfind(':');
+    auto const bracket = authority.rfind(']');
+
+    if (colon != std::string_view::npos && (bracket == std::string_view::npos || colon > bracket))
+    {
+      auto const candidate = authority.substr(colon + 1);
+
+      if (std::all_of(std::begin(candidate), std::end(candidate), [](char c)
+            { return c >= '0' && c <= '9'; }))
+      {
+        host = authority.substr(0, colon);
+        port = candidate;
+        has_port = true;
+      }
+    }
+
+    // The host is case insensitive, so lowercase it
+    out = normalise_percent_encoding(host, out, true);
+
+    if (has_port && !is_default_port(scheme, port))
+    {
+      *out++ = ':';
+      out = std::copy(std::begin(port), std::end(port), out);
+    }
+  }
+
+  // Normalise the path, then remove any dot-segments from it in place
+  auto path_end = input.find_first_of("?#", pos);
+  if (path_end == std::string_view::npos)
+  {
+    path_end = len;
+  }
+
+  // The hash is built up as each component is finished with, while it's still in cache, rather than going back over the whole output at the
+  // end. The scheme and authority never change once written, but the path can't be hashed until its dot-segments have been removed
+  char *path_start = out;
+  auto hash = fnv1a(fnv1a_basis, output, path_start);
+
+  out = normalise_percent_encoding(input.substr(pos, path_end - pos), out, false);
+  out = remove_dot_segments(path_start, out);
+  hash = fnv1a(hash, path_start, out);
+
+  // The query and fragment only need their percent-encoding normalising
+  char *query_start = out;
+  out = normalise_percent_encoding(input.substr(path_end), out, false);
+  hash = fnv1a(hash, query_start, out);
+
+  return canonical_url{static_cast<std::size_t>(out - output), hash};
+}
+
+
+////////////////////////////////////////////////////////////
+auto canonicalise(std::string_view input, std::string &output) -> uint64_t
+{
+  // Canonicalisation never makes anything longer, so resizing to the input size reuses any existing capacity in the output
+  output.resize(input.size());
+
+  auto const result = canonicalise(input, output.data());
+  output.resize(result.size);
+
+  return result.hash;
+}
+
 } // namespace hmr::url
@@ -1,7 +1,14 @@
 #define CATCH_CONFIG_MAIN // This tells the Catch2 header to generate a main
 
+#include <filesystem>
+#include <fstream>
+#include <sstream>
 #include <string>
 #include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <hamarr/format.hpp>
@@ -20,6 +27,7 @@
 #include "catch.hpp"
 
 using namespace std::string_literals;
+using namespace std::string_view_literals;
 
 // hmr::fmt
 TEST_CASE("hmr::fmt", "[formatting]")
@@ -28,9 +36,70 @@ TEST_CASE("hmr::fmt", "[formatting]")
   REQUIRE(hmr::fmt::to_upper(input) == "HELLO,\nWORLD!"s);
   REQUIRE(hmr::fmt::to_lower(input) == "hello,\nworld!"s);
 
+  // Long enough to exercise the SIMD path, including the boundary chars either side of each range of letters
+  auto const case_test = "@AZ[`az{ The Quick Brown Fox Jumps Over The Lazy Dog \xC0\xE0\xC9\xE9 0123456789"s;
+  REQUIRE(hmr::fmt::to_upper(case_test) == "@AZ[`AZ{ THE QUICK BROWN FOX JUMPS OVER THE LAZY DOG \xC0\xE0\xC9\xE9 0123456789"s);
+  REQUIRE(hmr::fmt::to_lower(case_test) == "@az[`az{ the quick brown fox jumps over the lazy dog \xC0\xE0\xC9\xE9 0123456789"s);
+
+  auto in_place = case_test;
+  hmr::fmt::to_lower_inplace(in_place);
+  REQUIRE(in_place == hmr::fmt::to_lower(case_test));
+  hmr::fmt::to_upper_inplace(in_place.data() + 9, 3);
+  REQUIRE(in_place.substr(0, 16) == "@az[`az{ THE qui"s);
+
+  REQUIRE(hmr::fmt::iequals(case_test, hmr::fmt::to_upper(case_test)));
+  REQUIRE(hmr::fmt::iequals(case_test, hmr::fmt::to_lower(case_test)));
+  REQUIRE_FALSE(hmr::fmt::iequals("@"sv, "`"sv));
+  REQUIRE_FALSE(hmr::fmt::iequals("[{"sv, "{["sv));
+  REQUIRE_FALSE(hmr::fmt::iequals(case_test, case_test.substr(1)));
+  REQUIRE(hmr::fmt::istarts_with(case_test, "@az[`AZ{ the"sv));
+  REQUIRE_FALSE(hmr::fmt::istarts_with("abc"sv, "abcd"sv));
+  REQUIRE(hmr::fmt::ifind(case_test, "LAZY DOG"sv) == case_test.find("Lazy Dog"));
+  REQUIRE(hmr::fmt::ifind(case_test, "o"sv, 20) == case_test.find('o', 20));
+  REQUIRE(hmr::fmt::ifind(case_test, "lazy cat"sv) == std::string_view::npos);
+  REQUIRE(hmr::fmt::ifind(case_test, ""sv, 3) == 3);
+  REQUIRE(hmr::fmt::ihash(case_test) == hmr::fmt::ihash(hmr::fmt::to_upper(case_test)));
+  REQUIRE(hmr::fmt::ihash("abc"sv) != hmr::fmt::ihash("abd"sv));
+
+  auto headers = std::unordered_map<std::string, int, hmr::fmt::case_insensitive_hash, hmr::fmt::case_insensitive_equal>{{"Content-Length", 42}};
+  REQUIRE(headers.count("content-length") == 1);
+  REQUIRE(headers.at("CONTENT-LENGTH") == 42);
+
   REQUIRE(hmr::fmt::escape(input) == "Hello,\\nWorld!"s);
   REQUIRE(hmr::fmt::unescape("Hello,\\nWorld!"s) == input);
 
+  // Long enough to exercise the SIMD scan for bytes that need escaping, with a mix of clean runs and escapes
+  auto const escape_test = "Tab\there, backslash \\ and \r\n then a long clean run of printable text \x7F\x80\xFF\x00!"s;
+  auto const escaped = "Tab\\x09here, backslash \\\\ and \\r\\n then a long clean run of printable text \\x7F\\x80\\xFF\\x00!"s;
+  REQUIRE(hmr::fmt::escape(escape_test) == escaped);
+  REQUIRE(hmr::fmt::unescape(escaped) == escape_test);
+  REQUIRE(hmr::fmt::unescape("\\a\\b\\t\\v\\f\\q\\x4a\\x4B"s) == "\a\b\t\v\fqJK"s);
+
+  auto unescape_in_place = escaped;
+  hmr::fmt::unescape_inplace(unescape_in_place);
+  REQUIRE(unescape_in_place == escape_test);
+
+  REQUIRE_THROWS_AS(hmr::fmt::unescape("abc\\"s), hmr::xcpt::format::need_more_data);
+  REQUIRE_THROWS_AS(hmr::fmt::unescape("abc\\x4"s), hmr::xcpt::format::need_more_data);
+  REQUIRE_THROWS_AS(hmr::fmt::unescape("abc\\x4G"s), hmr::xcpt::hex::invalid_input);
+
+  using hmr::fmt::escape_mode;
+  auto const literal_test = "Say \"hi\"\tthen \\ and \x01\x7F caf\xC3\xA9 with a long enough clean run for SIMD"s;
+  REQUIRE(hmr::fmt::escape(literal_test, escape_mode::json) == "Say \\\"hi\\\"\\tthen \\\\ and \\u0001\x7F caf\xC3\xA9 with a long enough clean run for SIMD"s);
+  REQUIRE(hmr::fmt::escape(literal_test, escape_mode::c_literal) == "Say \\\"hi\\\"\\tthen \\\\ and \\001\\177 caf\\303\\251 with a long enough clean run for SIMD"s);
+  REQUIRE(hmr::fmt::unescape(hmr::fmt::escape(literal_test, escape_mode::json), escape_mode::json) == literal_test);
+  REQUIRE(hmr::fmt::unescape(hmr::fmt::escape(literal_test, escape_mode::c_literal), escape_mode::c_literal) == literal_test);
+  REQUIRE(hmr::fmt::unescape("\\/\\u00e9\\ud83d\\ude00"s, escape_mode::json) == "/\xC3\xA9\xF0\x9F\x98\x80"s);
+  REQUIRE(hmr::fmt::unescape("\\101\\x42\\0\\?\\u00e9"s, escape_mode::c_literal) == "AB\0?\xC3\xA9"s);
+  REQUIRE_THROWS_AS(hmr::fmt::unescape("\\q"s, escape_mode::json), hmr::xcpt::format::invalid_input);
+  REQUIRE_THROWS_AS(hmr::fmt::unescape("\\ud83dx"s, escape_mode::json), hmr::xcpt::format::need_more_data);
+  REQUIRE_THROWS_AS(hmr::fmt::unescape("\\ude00"s, escape_mode::json), hmr::xcpt::format::invalid_input);
+  REQUIRE_THROWS_AS(hmr::fmt::unescape("\\x100"s, escape_mode::c_literal), hmr::xcpt::format::invalid_input);
+  REQUIRE_THROWS_AS(hmr::fmt::unescape("\\u00ZZ"s, escape_mode::json), hmr::xcpt::format::invalid_input);
+  REQUIRE_THROWS_AS(hmr::fmt::unescape("\\ud83d\\uZZZZ"s, escape_mode::json), hmr::xcpt::format::invalid_input);
+  REQUIRE_THROWS_AS(hmr::fmt::unescape("\\xZZ"s, escape_mode::c_literal), hmr::xcpt::format::invalid_input);
+  REQUIRE_THROWS_AS(hmr::fmt::unescape("\\u00ZZ"s, escape_mode::c_literal), hmr::xcpt::format::invalid_input);
+
   auto const split_test = "AABBCCDD\nEEFFGG!"s;
   REQUIRE(hmr::fmt::split(split_test, '\n') == std::vector<std::string>{"AABBCCDD", "EEFFGG!"});
   REQUIRE(hmr::fmt::split(split_test, 'D') == std::vector<std::string>{"AABBCC", "\nEEFFGG!"});
@@ -43,6 +112,52 @@ TEST_CASE("hmr::fmt", "[formatting]")
   REQUIRE(hmr::fmt::split(split_test, "AF") == std::vector<std::string>{"BBCCDD\nEE", "GG!"});
   REQUIRE(hmr::fmt::split(split_test, "AF", true, false) == std::vector<std::string>{"", "BBCCDD\nEE", "GG!"});
   REQUIRE(hmr::fmt::split(split_test, "AF", false, false) == std::vector<std::string>{"", "", "BBCCDD\nEE", "", "GG!"});
+  REQUIRE(hmr::fmt::split("a,bc,,d,"s, ',') == std::vector<std::string>{"a", "bc", "d"});
+  REQUIRE(hmr::fmt::split("a,bc,,d,"s, ',', false) == std::vector<std::string>{"a", "bc", "", "d", ""});
+  REQUIRE(hmr::fmt::split(""s, ',', false, false).empty());
+
+  auto views = std::vector<std::string_view>{};
+  hmr::fmt::split_into(views, split_test, "AF", false, false);
+  REQUIRE(views == std::vector<std::string_view>{"", "", "BBCCDD\nEE", "", "GG!"});
+  hmr::fmt::split_into(views, split_test, 'D');
+  REQUIRE(views == std::vector<std::string_view>{"AABBCC", "\nEEFFGG!"});
+  REQUIRE(views[0].data() == split_test.data());
+
+  auto const lazy = hmr::fmt::split_view(split_test, 'A', false, false);
+  REQUIRE(std::vector<std::string_view>(std::begin(lazy), std::end(lazy)) == std::vector<std::string_view>{"", "", "BBCCDD\nEEFFGG!"});
+
+  auto const sequence_test = "first\r\nsecond\r\n\r\nthird --> fourth -->\r\n the --- final -->> segment, which is long enough to need several blocks\r\n"s;
+  REQUIRE(hmr::fmt::split(sequence_test, "\r\n", hmr::fmt::delimiter_mode::whole_string) == std::vector<std::string>{"first", "second", "third --> fourth -->", " the --- final -->> segment, which is long enough to need several blocks"});
+  REQUIRE(hmr::fmt::split(sequence_test, "\r\n", hmr::fmt::delimiter_mode::whole_string, false) == std::vector<std::string>{"first", "second", "", "third --> fourth -->", " the --- final -->> segment, which is long enough to need several blocks", ""});
+  hmr::fmt::split_into(views, sequence_test, "-->", hmr::fmt::delimiter_mode::whole_string);
+  REQUIRE(views == std::vector<std::string_view>{"first\r\nsecond\r\n\r\nthird ", " fourth ", "\r\n the --- final ", "> segment, which is long enough to need several blocks\r\n"});
+  REQUIRE(hmr::fmt::split("||a||||b|||c"s, "||", hmr::fmt::delimiter_mode::whole_string) == std::vector<std::string>{"a", "b", "|c"});
+  auto const stored_view = hmr::fmt::split_view("a-->b-->c"sv, std::string("-->"), hmr::fmt::delimiter_mode::whole_string);
+  REQUIRE(std::vector<std::string_view>(stored_view.begin(), stored_view.end()) == std::vector<std::string_view>{"a", "b", "c"});
+
+  // Long enough to exercise the SIMD scanning, with delimiter sets that can and can't be represented by the nibble lookup tables
+  auto const long_split_test = "The quick brown fox, jumps over; the lazy dog.\tPack my box\nwith five dozen liquor jugs!\x80\xFF" "End"s;
+  REQUIRE(hmr::fmt::split(long_split_test, " \t\n,;.!") == std::vector<std::string>{"The", "quick", "brown", "fox", "jumps", "over", "the", "lazy", "dog", "Pack", "my", "box", "with", "five", "dozen", "liquor", "jugs", "\x80\xFF" "End"});
+  REQUIRE(hmr::fmt::split(long_split_test, "\x01\x12#4EV~\x9A\xAB\xCD") == std::vector<std::string>{"The quick brown fox, jumps over; the lazy dog.\tPack my box\nwith five dozen liquor jugs!\x80\xFF", "nd"});
+
+  // Parallel splitting should give the same segments as split_view, no matter how the input is divided between threads
+  auto const parallel_test = "\nline 1\nline 2\n\n\nline 3 is a bit longer than the others\nline 4\n\n"s;
+  for (std::size_t threads = 1; threads <= 8; ++threads)
+  {
+    for (auto const &[collapse, ignore_leading] : {std::pair{true, true}, std::pair{false, true}, std::pair{true, false}, std::pair{false, false}})
+    {
+      auto expected = std::vector<std::pair<std::size_t, std::size_t>>{};
+      for (auto const segment : hmr::fmt::split_view(parallel_test, '\n', collapse, ignore_leading))
+      {
+        auto const begin = static_cast<std::size_t>(segment.data() - parallel_test.data());
+        expected.emplace_back(begin, begin + segment.size());
+      }
+
+      REQUIRE(hmr::fmt::split_parallel(parallel_test, '\n', collapse, ignore_leading, threads) == expected);
+    }
+  }
+  REQUIRE(hmr::fmt::split_parallel("no delimiters"s, '\n') == std::vector<std::pair<std::size_t, std::size_t>>{{0, 13}});
+  REQUIRE(hmr::fmt::split_parallel(""s, '\n').empty());
 
   auto const strip_test_1 = "  \nThis is a test! "s;
   REQUIRE(hmr::fmt::lstrip(strip_test_1) == "This is a test! "s);
@@ -53,6 +168,124 @@ TEST_CASE("hmr::fmt", "[formatting]")
   REQUIRE(hmr::fmt::lstrip(strip_test_2, "ABC") == "This is a test!CBA"s);
   REQUIRE(hmr::fmt::rstrip(strip_test_2, "ABC") == "ABCThis is a test!"s);
   REQUIRE(hmr::fmt::strip(strip_test_2, "ABC") == "This is a test!"s);
+  REQUIRE(hmr::fmt::join(hmr::fmt::split(split_test, 'D', false), "D") == split_test);
+  REQUIRE(hmr::fmt::join(std::vector<std::string_view>{}, ", ").empty());
+  REQUIRE(hmr::fmt::join({"a", "", "b"}, ", ") == "a, , b");
+
+  auto output = hmr::fmt::builder{64};
+  output.append("id=").append_int(-1234).append(' ').append_int(uint64_t{18446744073709551615ULL}).append(' ').append_hex(uint16_t{0xBEEF});
+  output.append(' ').append_hex("\x01\xFF"sv, true).append(' ').append_hex("\x01\xFF"sv).append(' ').append_escaped("a\nb").append(2, '!');
+  REQUIRE(output.view() == "id=-1234 18446744073709551615 BEEF 01 FF 01FF a\\nb!!");
+  REQUIRE(std::move(output).str() == "id=-1234 18446744073709551615 BEEF 01 FF 01FF a\\nb!!");
+
+  REQUIRE(hmr::fmt::strip(" \t "s).empty());
+
+  REQUIRE(hmr::fmt::parse<int>("-42") == -42);
+  REQUIRE(hmr::fmt::parse<uint8_t>("255") == 255);
+  REQUIRE(hmr::fmt::parse<double>("0.125") == 0.125);
+  REQUIRE_THROWS_AS(hmr::fmt::parse<uint8_t>("256"), hmr::xcpt::format::invalid_input);
+  REQUIRE_THROWS_AS(hmr::fmt::parse<int>("42 "), hmr::xcpt::format::invalid_input);
+  REQUIRE_THROWS_AS(hmr::fmt::parse<int>("+-42"), hmr::xcpt::format::invalid_input);
+  REQUIRE_THROWS_AS(hmr::fmt::parse<double>(""), hmr::xcpt::format::invalid_input);
+
+  auto parsed_int = 7;
+  REQUIRE_FALSE(hmr::fmt::try_parse("x", parsed_int));
+  REQUIRE(parsed_int == 7);
+
+  uint64_t digits = 0;
+  REQUIRE(hmr::fmt::parse_digits("20240131235959", digits));
+  REQUIRE(digits == 20240131235959ULL);
+  REQUIRE(hmr::fmt::parse_digits("9999999999999999999", digits));
+  REQUIRE(digits == 9999999999999999999ULL);
+  REQUIRE_FALSE(hmr::fmt::parse_digits("2024013/", digits));
+  REQUIRE_FALSE(hmr::fmt::parse_digits("20240:31", digits));
+  REQUIRE_FALSE(hmr::fmt::parse_digits("", digits));
+
+  REQUIRE(hmr::fmt::parse_column<int32_t>(hmr::fmt::split("12345678,-1,+7,0", ',')) == std::vector<int32_t>{12345678, -1, 7, 0});
+  REQUIRE(hmr::fmt::parse_column<double>(std::vector<std::string_view>{"1.5", "-2"}) == std::vector<double>{1.5, -2.0});
+  REQUIRE_THROWS_AS(hmr::fmt::parse_column<int16_t>(std::vector<std::string_view>{"1", "40000"}), hmr::xcpt::format::invalid_input);
+
+  auto formatted = "value="s;
+  hmr::fmt::format_into(formatted, -1234);
+  formatted += ',';
+  hmr::fmt::format_into(formatted, 0.1);
+  REQUIRE(formatted == "value=-1234,0.1");
+
+  char small[2];
+  REQUIRE(hmr::fmt::format_into(std::begin(small), std::end(small), 123) == nullptr);
+
+  // The long line spans several 64 byte blocks of the newline scanner
+  auto const long_line = std::string(150, 'x');
+  auto const lines_test = "first\r\nsecond\n\n  \t \n"s + long_line + "\r\nlast"s;
+  auto const lines_expected = std::vector<std::string_view>{"first", "second", "", "  \t ", long_line, "last"};
+
+  auto lines = std::vector<std::string_view>{};
+  for (auto const line : hmr::fmt::line_reader{lines_test})
+  {
+    lines.push_back(line);
+  }
+  REQUIRE(lines == lines_expected);
+  REQUIRE(hmr::fmt::strip(lines[3]).empty());
+
+  // Removes the file however the test ends, so that a failed REQUIRE doesn't leave it behind
+  struct temp_file
+  {
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "hamarr_line_reader_test.txt";
+
+    ~temp_file()
+    {
+      auto ignored = std::error_code{};
+      std::filesystem::remove(path, ignored);
+    }
+  } const lines_file;
+
+  {
+    auto file = std::ofstream{lines_file.path, std::ios::binary};
+    file << lines_test << "\n";
+  }
+
+  auto reader = hmr::fmt::line_reader{hmr::fmt::mapped_file{lines_file.path.string()}};
+  lines.clear();
+  for (auto line = std::string_view{}; reader.next(line);)
+  {
+    lines.push_back(line);
+  }
+  REQUIRE(lines == lines_expected);
+
+  REQUIRE(hmr::fmt::mapped_file{}.view().empty());
+  REQUIRE_THROWS_AS(hmr::fmt::mapped_file{"this/file/does/not/exist"}, hmr::xcpt::format::file_error);
+
+  // The quoted field spans a 64 byte block boundary, so the quote state has to carry over between blocks
+  auto const csv_test = "id,name,notes\r\n1,\"Smith, John\",\"said \"\"hi\"\"\"\r\n\n2,,\"a quoted field that is long enough to cross into the next block, with a\nnewline\"\n3,x,"s;
+  auto csv = hmr::fmt::csv_parser{};
+  REQUIRE(csv.parse(csv_test) == csv_test.size());
+  REQUIRE(csv.size() == 4);
+  REQUIRE(std::vector<std::string_view>(csv[0].begin(), csv[0].end()) == std::vector<std::string_view>{"id", "name", "notes"});
+  REQUIRE(csv[1][1] == "Smith, John");
+  REQUIRE(hmr::fmt::csv_unquote(csv[1][2]) == "said \"hi\"");
+  REQUIRE(csv[2].size() == 3);
+  REQUIRE(csv[2][1].empty());
+  REQUIRE(csv[2][2] == "a quoted field that is long enough to cross into the next block, with a\nnewline");
+  REQUIRE(csv[3].size() == 3);
+  REQUIRE(csv[3][2].empty());
+
+  // A quoted empty field is a real row, unlike a blank line
+  REQUIRE(csv.parse("a\n\"\"\n\nb\r\n\r\n\"\""sv) == 13);
+  REQUIRE(csv.size() == 4);
+  REQUIRE(csv[1].size() == 1);
+  REQUIRE(csv[1][0].empty());
+  REQUIRE(csv[2][0] == "b");
+  REQUIRE(csv[3].size() == 1);
+  REQUIRE(csv[3][0].empty());
+
+  // Streaming leaves the incomplete final row to be passed in again with the next chunk
+  auto tsv = hmr::fmt::csv_parser{'\t'};
+  REQUIRE(tsv.parse("a\tb\nc\t\"d\n"sv, false) == 4);
+  REQUIRE(tsv.size() == 1);
+  REQUIRE(tsv.parse("c\t\"d\ne\"\n"sv, false) == 8);
+  REQUIRE(tsv.size() == 1);
+  REQUIRE(tsv[0][1] == "d\ne");
+  REQUIRE_THROWS_AS(tsv.parse("\"unterminated"sv), hmr::xcpt::format::need_more_data);
 }
 
 // hmr::hex
@@ -116,6 +349,12 @@ TEST_CASE("hmr::hex", "[encoding][hex]")
   REQUIRE_THROWS(hmr::hex::decode<uint16_t>("FF FF FF"s) == uint16_t{}); // Too many bytes for the requested return type
   REQUIRE_THROWS(hmr::hex::decode<uint32_t>("FF FF FF FF FF FF"s) == uint32_t{}); // Too many bytes for the requested return type
   REQUIRE_THROWS(hmr::hex::decode<uint64_t>("AA BB CC DD EE FF 00 11 22 33 44 55 66 77 88 99"s) == uint64_t{}); // Too many bytes for the requested return type
+
+  // Dump - one full line plus a partial line
+  REQUIRE(hmr::hex::dump("Some data with\na mix"s) ==
+          "00000000  53 6F 6D 65 20 64 61 74  61 20 77 69 74 68 0A 61  |Some data with.a|\n"
+          "00000010  20 6D 69 78                                       | mix|\n"
+          "00000014"s);
 }
 
 // hmr::binary
@@ -223,6 +462,35 @@ TEST_CASE("hmr::url", "[encoding][url]")
   REQUIRE_THROWS(hmr::url::decode("Invalid UTF-8 -> ASCII conversion %C4%11"s) == std::string{});
   REQUIRE_THROWS(hmr::url::decode("Invalid second half of UTF-8 -> ASCII conversion %C2%ZZ"s) == std::string{});
   REQUIRE_THROWS(hmr::url::decode("Unprintable chars mixed in %1\x98"s) == std::string{});
+
+  // Query strings
+  auto const query = hmr::url::parse_query("?a=1&b=x%20y+z&&flag&c=%C3%A9"s);
+  REQUIRE(query.pairs.size() == 4);
+  REQUIRE(query.pairs[0] == std::pair{"a"sv, "1"sv});
+  REQUIRE(query.pairs[1] == std::pair{"b"sv, "x y z"sv});
+  REQUIRE(query.pairs[2] == std::pair{"flag"sv, ""sv});
+  REQUIRE(query.pairs[3] == std::pair{"c"sv, "\xE9"sv});
+  REQUIRE(hmr::url::parse_query(""s).pairs.empty());
+  REQUIRE_THROWS(hmr::url::parse_query("a=%2"s));
+
+  // Canonicalisation
+  auto canonical = std::string{};
+  auto const hash = hmr::url::canonicalise("HTTP://User@Example.COM:80/a/./b/../c/%7euser%2f%2a?Q=%3d#Frag"s, canonical);
+  REQUIRE(canonical == "http://User@example.com/a/c/~user%2F%2A?Q=%3D#Frag"s);
+
+  // The hash is built up a component at a time, but must match a plain FNV-1a of the whole canonical URL
+  auto whole_hash = uint64_t{0xCBF29CE484222325};
+  for (auto const ch : canonical)
+  {
+    whole_hash = (whole_hash ^ static_cast<uint8_t>(ch)) * 0x100000001B3;
+  }
+  REQUIRE(hash == whole_hash);
+  REQUIRE(hmr::url::canonicalise("http://user@example.com/a/c/%7Euser%2F%2a?Q=%3D#Frag"s, canonical) != hash);
+  REQUIRE(hmr::url::canonicalise("http://User@example.com:/a/c/~user%2f%2A?Q=%3d#Frag"s, canonical) == hash);
+  REQUIRE(hmr::url::canonicalise("https://[::1]:8443/../../x/.."s, canonical) != hash);
+  REQUIRE(canonical == "https://[::1]:8443/"s);
+  hmr::url::canonicalise("ftp://files.example.com:21/pub/%zz"s, canonical);
+  REQUIRE(canonical == "ftp://files.example.com/pub/%zz"s);
 }
 
 // hmr::prng
@@ -248,6 +516,29 @@ TEST_CASE("hmr::bitwise", "[obfuscation][xor][bitshift][rotate]")
   REQUIRE(hmr::bitwise::xor_with_key(input, "great key"s) == hmr::hex::decode("2F 17 09 0D 1B 0C 4B 32 16 15 1E 01 40"s));
   REQUIRE(hmr::bitwise::xor_with_key("12345678"s, "ABC\xFF"s) == hmr::hex::decode("70 70 70 cb 74 74 74 c7"s));
 
+  // Long enough for the SIMD path, with keys that do and don't divide the vector width
+  auto long_input = std::string(203, '\0');
+  for (std::size_t i = 0; i < long_input.size(); ++i)
+  {
+    long_input[i] = static_cast<char>(i * 37);
+  }
+  // Keys of 64 bytes or more are XORed straight from the key rather than expanded first, so try either side of that and a long one
+  auto long_key = std::string(100, '\0');
+  for (std::size_t i = 0; i < long_key.size(); ++i)
+  {
+    long_key[i] = static_cast<char>(i * 13 + 1);
+  }
+  for (auto const &key : {"k"s, "ab"s, "great key"s, std::string(16, '\x5A'), hmr::hex::decode("01 02 03 04 05 06 07 08 09 0A 0B 0C 0D 0E 0F 10 11 12 13 14 15 16 17 18 19 1A 1B 1C 1D 1E 1F 20 21"s), long_key.substr(0, 63), long_key.substr(0, 64), long_key})
+  {
+    auto const xord = hmr::bitwise::xor_with_key(long_input, key);
+    REQUIRE(xord.size() == long_input.size());
+    for (std::size_t i = 0; i < long_input.size(); ++i)
+    {
+      REQUIRE(xord[i] == static_cast<char>(long_input[i] ^ key[i % key.size()]));
+    }
+  }
+  REQUIRE(hmr::bitwise::xor_with_key(input, ""sv) == input);
+
   // Char as key
   REQUIRE(hmr::bitwise::xor_with_key(input, 'c') == hmr::hex::decode("2b 06 0f 0f 0c 4f 43 34 0c 11 0f 07 42"s));
 
@@ -259,12 +550,39 @@ TEST_CASE("hmr::bitwise", "[obfuscation][xor][bitshift][rotate]")
   REQUIRE(hmr::bitwise::xor_rolling("12345678"s) == hmr::hex::decode("31 03 01 07 01 03 01 0F"s));
   REQUIRE(hmr::bitwise::xor_rolling("12345678"s, hmr::bitwise::xor_differential::output) == hmr::hex::decode("31 03 30 04 31 07 30 08"s));
 
+  REQUIRE(hmr::bitwise::xor_rolling(""s).empty());
+  REQUIRE(hmr::bitwise::xor_rolling(""s, hmr::bitwise::xor_differential::output).empty());
+
+  // Long enough for the SIMD paths, and split across threads, which must all give the same result as a plain running XOR
+  auto running_xor = std::string(long_input.size(), '\0');
+  auto previous_xor = '\0';
+  for (std::size_t i = 0; i < long_input.size(); ++i)
+  {
+    running_xor[i] = previous_xor = static_cast<char>(previous_xor ^ long_input[i]);
+  }
+  for (std::size_t threads = 1; threads <= 4; ++threads)
+  {
+    REQUIRE(hmr::bitwise::xor_rolling(long_input, hmr::bitwise::xor_differential::output, threads) == running_xor);
+  }
+  REQUIRE(hmr::bitwise::xor_rolling(running_xor) == long_input);
+
   // Counter XOR
   REQUIRE(hmr::bitwise::xor_counter(input) == hmr::hex::decode("48 64 6E 6F 6B 29 26 50 67 7B 66 6F 2D"s));
   REQUIRE(hmr::bitwise::xor_counter(input, '\xAA') == hmr::hex::decode("E2 CE C0 C1 C1 83 90 E6 DD C1 D8 D1 97"s));
   REQUIRE(hmr::bitwise::xor_counter(input, '\xEF', 6) == hmr::hex::decode("A7 90 97 6D 68 21 33 4E 70 57 47 55 16"s));
   REQUIRE(hmr::bitwise::xor_counter(input, '\x04', -2) == hmr::hex::decode("4C 67 6C 92 93 D6 D8 A1 9B 80 9C 8A CD"s));
 
+  // Long enough for the SIMD paths, and split into chunks at an offset into the key stream
+  auto counter_key = uint8_t{0x37};
+  auto counter_xord = std::string{};
+  for (auto const ch : long_input)
+  {
+    counter_xord.push_back(static_cast<char>(static_cast<uint8_t>(ch) ^ counter_key));
+    counter_key = static_cast<uint8_t>(counter_key - 3);
+  }
+  REQUIRE(hmr::bitwise::xor_counter(long_input, 0x37, -3) == counter_xord);
+  REQUIRE(hmr::bitwise::xor_counter(long_input.substr(0, 77), 0x37, -3) + hmr::bitwise::xor_counter(long_input.substr(77), 0x37, -3, 77) == counter_xord);
+
   // Bit shift
   REQUIRE(hmr::binary::encode(hmr::bitwise::shift_left(hmr::binary::decode("00000001"s))) == "00000010"s);
   REQUIRE(hmr::binary::encode(hmr::bitwise::shift_left(hmr::binary::decode("00000001"s), 7)) == "10000000"s);
@@ -294,6 +612,38 @@ TEST_CASE("hmr::bitwise", "[obfuscation][xor][bitshift][rotate]")
   REQUIRE(hmr::binary::encode(hmr::bitwise::rotate_left(hmr::binary::decode("10000000 00000000 11111111 00000001"s), 20, hmr::bitwise::carry_through::enabled)) == "11110000 00011000 00000000 00001111"s);
   REQUIRE(hmr::binary::encode(hmr::bitwise::rotate_right(input, 2, hmr::bitwise::carry_through::enabled)) == "01010010 00011001 01011011 00011011 00011011 11001011 00001000 00010101 11011011 11011100 10011011 00011001 00001000"s);
   REQUIRE(hmr::binary::encode(hmr::bitwise::rotate_right(hmr::binary::decode("10001000 01110111 00110010"s), 7, hmr::bitwise::carry_through::enabled)) == "01100101 00010000 11101110"s);
+  REQUIRE(hmr::bitwise::rotate_left(""s, 3, hmr::bitwise::carry_through::enabled).empty());
+
+  // In place, over enough data for the SIMD paths
+  auto const long_text = "The quick brown fox jumps over the lazy dog, then does it all again!"s;
+  auto in_place = long_text;
+  hmr::bitwise::xor_with_key_inplace(in_place, "key"sv);
+  REQUIRE(in_place == hmr::bitwise::xor_with_key(long_text, "key"sv));
+  hmr::bitwise::xor_with_key_inplace(in_place.data(), in_place.size(), "key"sv);
+  REQUIRE(in_place == long_text);
+  hmr::bitwise::xor_counter_inplace(in_place, '\x10', 3);
+  REQUIRE(in_place == hmr::bitwise::xor_counter(long_text, '\x10', 3));
+  in_place = long_text;
+  hmr::bitwise::shift_left_inplace(in_place, 3);
+  REQUIRE(in_place == hmr::bitwise::shift_left(long_text, 3));
+  in_place = long_text;
+  hmr::bitwise::shift_right_inplace(in_place, 8);
+  REQUIRE(in_place == std::string(long_text.size(), '\0'));
+  in_place = long_text;
+  hmr::bitwise::rotate_left_inplace(in_place, 3);
+  hmr::bitwise::rotate_right_inplace(in_place, 3);
+  REQUIRE(in_place == long_text);
+  hmr::bitwise::rotate_right_inplace(in_place, 29, hmr::bitwise::carry_through::enabled);
+  REQUIRE(in_place == hmr::bitwise::rotate_right(long_text, 29, hmr::bitwise::carry_through::enabled));
+
+  // XORing two buffers together
+  auto const other_text = std::string(long_text.rbegin(), long_text.rend());
+  auto const xor_both = hmr::bitwise::xor_buffers(long_text, other_text);
+  REQUIRE(hmr::bitwise::xor_buffers(xor_both, other_text) == long_text);
+  in_place = long_text;
+  hmr::bitwise::xor_buffers(in_place, other_text, in_place.data());
+  REQUIRE(in_place == xor_both);
+  REQUIRE_THROWS_AS(hmr::bitwise::xor_buffers("abc"sv, "ab"sv), hmr::xcpt::bitwise::invalid_input);
 }
 
 // hmr::analysis
@@ -381,11 +731,160 @@ TEST_CASE("hmr::kvp", "[serialisation][kvp]")
 
   REQUIRE(hmr::kvp::serialise(kvps) == "key1=value1&key2=value2&key3=value3"s);
   REQUIRE(hmr::kvp::deserialise("key1=value1&key2=value2&key3=value3"s) == kvps);
+  REQUIRE(hmr::kvp::serialise(hmr::kvp::kvps{}).empty());
+  REQUIRE(hmr::kvp::serialise(kvps, ':', ';') == "key1:value1;key2:value2;key3:value3"s);
+
+  auto const awkward = hmr::kvp::kvps{{"a b", "1&2=3"}, {"caf\xE9", ""}};
+  REQUIRE(hmr::kvp::serialise(awkward, '=', '&', true) == "a%20b=1%262%3D3&caf%C3%A9="s);
+
+  auto appended = "?"s;
+  hmr::kvp::serialise(kvps, appended);
+  REQUIRE(appended == "?key1=value1&key2=value2&key3=value3"s);
+
+  auto stream = std::ostringstream{};
+  hmr::kvp::serialise(awkward, stream, '=', '&', true);
+  REQUIRE(stream.str() == hmr::kvp::serialise(awkward, '=', '&', true));
 
   // Failures
   REQUIRE_THROWS(hmr::kvp::deserialise("key1=value1=value2") == std::map<std::string, std::string>{});
   REQUIRE_THROWS(hmr::kvp::deserialise("key1=value1&something&key2=value2") == std::map<std::string, std::string>{});
   REQUIRE_THROWS(hmr::kvp::deserialise("key1=value1& &key2=value2") == std::map<std::string, std::string>{});
+
+  // Views into the input, in order and keeping duplicates, without allocating for small inputs
+  auto const views = hmr::kvp::deserialise_view("b=2;a=1;b=3"sv, '=', ';');
+  REQUIRE(views.size() == 3);
+  REQUIRE(views.is_inline());
+  REQUIRE(views[0] == std::pair{"b"sv, "2"sv});
+  REQUIRE(views[2] == std::pair{"b"sv, "3"sv});
+  REQUIRE(hmr::kvp::deserialise("b=2;a=1;b=3"sv, '=', ';') == std::map<std::string, std::string>{{"a", "1"}, {"b", "3"}});
+  REQUIRE(hmr::kvp::deserialise_view(""sv).empty());
+  REQUIRE_THROWS_AS(hmr::kvp::deserialise_view("key1=value1&something"sv), hmr::xcpt::kvp::parse_error);
+
+  // Growing beyond the inline capacity moves the pairs to the heap
+  auto many_pairs = std::string{};
+  for (auto i = 0; i < 40; ++i)
+  {
+    many_pairs += "k" + std::to_string(i) + "=v" + std::to_string(i) + "&";
+  }
+  auto many_views = hmr::kvp::deserialise_view(many_pairs);
+  REQUIRE(many_views.size() == 40);
+  REQUIRE_FALSE(many_views.is_inline());
+  REQUIRE(many_views[39] == std::pair{"k39"sv, "v39"sv});
+
+  auto moved_views = std::move(many_views);
+  REQUIRE(moved_views.size() == 40);
+  REQUIRE(many_views.empty());
+  auto copied_views = moved_views;
+  REQUIRE(copied_views == moved_views);
+
+  // Other destination containers
+  auto const unordered = hmr::kvp::deserialise<std::unordered_map<std::string, std::string>>("b=2;a=1;b=3"sv, '=', ';');
+  REQUIRE(unordered == std::unordered_map<std::string, std::string>{{"a", "1"}, {"b", "3"}});
+  auto streamed = std::unordered_map<std::string, std::string>{};
+  hmr::kvp::deserialise_into(streamed, many_pairs);
+  REQUIRE(streamed.size() == 40);
+  REQUIRE(streamed.at("k39") == "v39");
+  REQUIRE_THROWS_AS(hmr::kvp::deserialise_into(streamed, "x=1&y"sv), hmr::xcpt::kvp::parse_error);
+  REQUIRE(streamed.at("x") == "1");
+
+  auto flat = hmr::kvp::deserialise<hmr::kvp::flat_kvps>("c=3&b=2&a=1&b=4"sv);
+  REQUIRE(flat.size() == 3);
+  REQUIRE(flat.begin()->first == "a");
+  REQUIRE(flat.at("b"sv) == "4");
+  REQUIRE(flat.contains("c"sv));
+  REQUIRE_FALSE(flat.contains("d"sv));
+  REQUIRE_THROWS_AS(flat.at("d"sv), std::out_of_range);
+  hmr::kvp::deserialise_into(flat, "d=5&a=0"sv);
+  REQUIRE(flat.size() == 4);
+  REQUIRE(flat["a"sv] == "0");
+  REQUIRE(flat["d"sv] == "5");
+  flat.at("d"sv) = "6";
+  REQUIRE(std::as_const(flat).at("d"sv) == "6");
+  REQUIRE_THROWS_AS(flat.at("e"sv) = "7", std::out_of_range);
+  static_assert(std::is_same_v<decltype(flat.begin()), hmr::kvp::flat_kvps::const_iterator>);
+
+  // Callbacks, with early termination and key filtering
+  auto visited = std::vector<std::pair<std::string_view, std::string_view>>{};
+  REQUIRE(hmr::kvp::for_each_pair("a=1&b=2&c=3"sv, [&visited](auto key, auto value) { visited.emplace_back(key, value); }));
+  REQUIRE(visited == std::vector<std::pair<std::string_view, std::string_view>>{{"a", "1"}, {"b", "2"}, {"c", "3"}});
+  visited.clear();
+  REQUIRE_FALSE(hmr::kvp::for_each_pair("a=1&b=2&c=3"sv, [&visited](auto key, auto value) { visited.emplace_back(key, value); return key != "b"; }));
+  REQUIRE(visited.size() == 2);
+  REQUIRE_THROWS_AS(hmr::kvp::for_each_pair("a=1&b"sv, [](auto, auto) {}), hmr::xcpt::kvp::parse_error);
+
+  auto const filter = hmr::kvp::key_filter{"user", "id", "session", "id"};
+  REQUIRE(filter.size() == 3);
+  REQUIRE(filter.index_of("session"sv) == 2);
+  REQUIRE(filter.index_of("sessions"sv) == hmr::kvp::key_filter::npos);
+  REQUIRE_FALSE(hmr::kvp::key_filter{}.contains(""sv));
+  visited.clear();
+  REQUIRE(hmr::kvp::for_each_pair("id=7;page=2;user=bob;ua=x"sv, filter, [&visited](auto key, auto value) { visited.emplace_back(key, value); }, '=', ';'));
+  REQUIRE(visited == std::vector<std::pair<std::string_view, std::string_view>>{{"id", "7"}, {"user", "bob"}});
+
+  auto many_keys = std::vector<std::string>{};
+  for (auto i = 0; i < 2000; ++i)
+  {
+    many_keys.push_back("key" + std::to_string(i));
+  }
+  auto const big_filter = hmr::kvp::key_filter(std::vector<std::string_view>(many_keys.begin(), many_keys.end()));
+  REQUIRE(big_filter.size() == 2000);
+  REQUIRE(big_filter.table_size() <= 4 * big_filter.size());
+  for (auto i = 0; i < 2000; ++i)
+  {
+    REQUIRE(big_filter.index_of(many_keys[static_cast<std::size_t>(i)]) == static_cast<std::size_t>(i));
+    REQUIRE_FALSE(big_filter.contains("yek" + std::to_string(i)));
+  }
+
+  // Columnar batches
+  auto const records = std::vector<std::string_view>{"ip=1.2.3.4&status=200"sv, "ip=5.6.7.8&status=404"sv, "status=500&ip=9.9.9.9&slow=1&ip=0.0.0.0"sv, ""sv};
+  auto const table = hmr::kvp::parse_batch(records);
+  REQUIRE(table.rows() == 4);
+  REQUIRE(table.keys() == std::vector<std::string>{"ip", "status", "slow"});
+  REQUIRE(table.column("status"sv) == std::vector<std::string_view>{"200", "404", "500", ""});
+  REQUIRE(table.column("ip"sv) == std::vector<std::string_view>{"1.2.3.4", "5.6.7.8", "0.0.0.0", ""});
+  REQUIRE(table.column(table.column_index("slow"sv)) == std::vector<std::string_view>{"", "", "1", ""});
+  REQUIRE(table.column_index("missing"sv) == hmr::kvp::kvp_table::npos);
+  REQUIRE_THROWS_AS(table.column("missing"sv), std::out_of_range);
+
+  // Interned keys
+  auto pool = hmr::kvp::intern_pool{};
+  auto const first_record = hmr::kvp::deserialise("user=alice&role=admin"sv, pool);
+  auto const second_record = hmr::kvp::deserialise("role=guest&user=bob&user=carol"sv, pool);
+  REQUIRE(pool.size() == 2);
+  REQUIRE(pool.find("user"sv) == pool.intern("user"sv));
+  REQUIRE(pool.find("user"sv).view() == "user");
+  REQUIRE(pool.find("nobody"sv).empty());
+  REQUIRE(first_record.at(pool.find("user"sv)) == "alice");
+  REQUIRE(second_record.at(pool.find("user"sv)) == "carol");
+  REQUIRE(second_record.count(pool.find("nobody"sv)) == 0);
+  REQUIRE(first_record.find(pool.find("role"sv))->first == second_record.find(pool.find("role"sv))->first);
+
+  // Binary encoding
+  auto const binary = hmr::kvp::serialise_binary(kvps);
+  REQUIRE(binary == "HKV\x01\x01\x03\x00\x00\x00\x00\x0C\x00\x00\x00\x18\x00\x00\x00\x04key1\x06value1\x04key2\x06value2\x04key3\x06value3"s);
+  REQUIRE(hmr::kvp::deserialise_binary(binary) == kvps);
+  REQUIRE(hmr::kvp::deserialise_binary(hmr::kvp::serialise_binary(kvps, false)) == kvps);
+  REQUIRE(hmr::kvp::deserialise_binary(hmr::kvp::serialise_binary(hmr::kvp::kvps{})).empty());
+
+  auto const long_value = std::string(300, 'x');
+  auto const long_binary = hmr::kvp::serialise_binary(hmr::kvp::kvps{{"a", "1"}, {"b", long_value}, {"c", "3"}});
+  auto const binary_view = hmr::kvp::binary_view{long_binary};
+  REQUIRE(binary_view.indexed());
+  REQUIRE(binary_view.size() == 3);
+  REQUIRE(binary_view.at("b"sv) == long_value);
+  REQUIRE_FALSE(binary_view.contains("bb"sv));
+  REQUIRE_THROWS_AS(binary_view.at("d"sv), std::out_of_range);
+  REQUIRE_THROWS_AS(hmr::kvp::binary_view{"key1=value1"sv}, hmr::xcpt::kvp::parse_error);
+  REQUIRE_THROWS_AS(hmr::kvp::deserialise_binary(binary.substr(0, binary.size() - 1)), hmr::xcpt::kvp::parse_error);
+
+#if __has_include(<memory_resource>)
+  auto arena = std::pmr::monotonic_buffer_resource{};
+  auto pmr_map = hmr::kvp::pmr_kvps{&arena};
+  hmr::kvp::deserialise_into(pmr_map, "key1=value1&key2=value2&key3=value3"sv);
+  REQUIRE(pmr_map.size() == 3);
+  REQUIRE(pmr_map.find("key2"sv)->second == "value2");
+  REQUIRE(pmr_map.find("key2"sv)->second.get_allocator().resource() == &arena);
+#endif
 }
 
 // hmr::uuid